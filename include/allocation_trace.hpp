@@ -0,0 +1,242 @@
+#pragma once
+
+// Allocation traces: a sequence of allocate/free/reallocate operations on
+// numbered slots, synthetic generators for them and a small binary file
+// format so that traces can be recorded once and replayed everywhere.
+//
+// File format, all integers little-endian:
+//     "ATRC"  magic
+//     u32     version (1)
+//     u64     operation count
+//     then per operation: u8 kind, u32 slot, u32 size.
+//
+// Slots are dense: every slot is below the operation count. An alloc takes
+// a free slot, free and realloc name a live one, and realloc sizes are not
+// 0 (realloc(p, 0) would be a free).
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <random>
+#include <vector>
+
+struct trace_op {
+    enum kind : std::uint8_t { alloc, free, realloc };
+
+    kind op;
+    std::uint32_t slot;  // Index of the live allocation.
+    std::uint32_t size;  // New size for alloc and realloc, 0 for free.
+};
+
+// Number of slots a replay needs.
+inline size_t trace_slot_count(const std::vector<trace_op>& trace) {
+    size_t count = 0;
+    for (const auto& op : trace) {
+        count = std::max(count, size_t{op.slot} + 1);
+    }
+    return count;
+}
+
+// Which live allocation a free picks.
+enum class free_order { lifo, fifo, random };
+
+// Random mix of allocations (sizes drawn by `next_size(rng)`) and frees,
+// staying around `target_live` live allocations; a `realloc_ratio` share of
+// the operations resizes a random live allocation instead. All allocations
+// are freed at the end.
+template <typename SizeSampler>
+std::vector<trace_op> synthetic_trace(size_t ops, size_t target_live,
+                                      free_order order, SizeSampler next_size,
+                                      std::uint64_t seed,
+                                      double realloc_ratio = 0) {
+    std::mt19937_64 rng{seed};
+    std::vector<trace_op> trace;
+    trace.reserve(ops + target_live);
+
+    // Oldest allocation at the front, newest at the back.
+    std::deque<std::uint32_t> live;
+    std::uint32_t next_slot = 0;
+    for (size_t i = 0; i < ops; ++i) {
+        if (!live.empty() && realloc_ratio > 0 &&
+            std::bernoulli_distribution{realloc_ratio}(rng)) {
+            std::uniform_int_distribution<size_t> pick(0, live.size() - 1);
+            trace.push_back({trace_op::realloc, live[pick(rng)],
+                             static_cast<std::uint32_t>(next_size(rng))});
+            continue;
+        }
+        // Bias towards allocation below the target and towards frees above.
+        double p_alloc = live.size() < target_live ? 0.7 : 0.3;
+        if (live.empty() || std::bernoulli_distribution{p_alloc}(rng)) {
+            trace.push_back({trace_op::alloc, next_slot,
+                             static_cast<std::uint32_t>(next_size(rng))});
+            live.push_back(next_slot++);
+            continue;
+        }
+
+        std::uint32_t slot = 0;
+        switch (order) {
+            case free_order::lifo:
+                slot = live.back();
+                live.pop_back();
+                break;
+            case free_order::fifo:
+                slot = live.front();
+                live.pop_front();
+                break;
+            case free_order::random: {
+                std::uniform_int_distribution<size_t> pick(0, live.size() - 1);
+                auto idx = pick(rng);
+                slot = live[idx];
+                live[idx] = live.back();
+                live.pop_back();
+                break;
+            }
+        }
+        trace.push_back({trace_op::free, slot, 0});
+    }
+    for (auto slot : live) {
+        trace.push_back({trace_op::free, slot, 0});
+    }
+    return trace;
+}
+
+// Sizes spread evenly over the orders of magnitude in [min_size, max_size].
+inline auto log_uniform_sizes(size_t min_size, size_t max_size) {
+    return [d = std::uniform_real_distribution<double>(
+                std::log2(min_size), std::log2(max_size))](auto& rng) mutable {
+        return static_cast<size_t>(std::exp2(d(rng)));
+    };
+}
+
+// Mostly small sizes with a long tail, as typical for heap users: 90% in
+// [16, 256], 9% up to 8 KiB and 1% up to 1 MiB.
+inline auto skewed_sizes() {
+    return [small = log_uniform_sizes(16, 256),
+            medium = log_uniform_sizes(256, 8 << 10),
+            large = log_uniform_sizes(8 << 10, 1 << 20),
+            pick = std::uniform_real_distribution<double>{}](
+               auto& rng) mutable {
+        double p = pick(rng);
+        return p < 0.90 ? small(rng) : p < 0.99 ? medium(rng) : large(rng);
+    };
+}
+
+// Log-uniform sizes in [min_size, max_size] freed in random order.
+inline std::vector<trace_op> random_trace(size_t ops, size_t target_live,
+                                          size_t min_size, size_t max_size,
+                                          std::uint64_t seed) {
+    return synthetic_trace(ops, target_live, free_order::random,
+                           log_uniform_sizes(min_size, max_size), seed);
+}
+
+// Fills the arena with small blocks, frees every other one and then runs a
+// random trace on the resulting checkerboard.
+inline std::vector<trace_op> fragmented_trace(size_t ops, size_t fill_count,
+                                              size_t block_size,
+                                              std::uint64_t seed) {
+    std::vector<trace_op> trace;
+    auto fill = static_cast<std::uint32_t>(fill_count);
+    for (std::uint32_t i = 0; i < fill; ++i) {
+        trace.push_back(
+            {trace_op::alloc, i, static_cast<std::uint32_t>(block_size)});
+    }
+    for (std::uint32_t i = 0; i < fill; i += 2) {
+        trace.push_back({trace_op::free, i, 0});
+    }
+    auto rest = random_trace(ops, fill_count / 4, block_size, 16 * block_size,
+                             seed);
+    for (auto op : rest) {
+        op.slot += fill;
+        trace.push_back(op);
+    }
+    for (std::uint32_t i = 1; i < fill; i += 2) {
+        trace.push_back({trace_op::free, i, 0});
+    }
+    return trace;
+}
+
+static_assert(std::endian::native == std::endian::little,
+              "trace files are written in host byte order");
+
+inline constexpr char trace_magic[4] = {'A', 'T', 'R', 'C'};
+inline constexpr std::uint32_t trace_version = 1;
+inline constexpr size_t trace_record_size = 9;
+
+inline bool write_trace(std::FILE* out, const std::vector<trace_op>& trace) {
+    const std::uint64_t count = trace.size();
+    if (std::fwrite(trace_magic, 1, 4, out) != 4 ||
+        std::fwrite(&trace_version, 4, 1, out) != 1 ||
+        std::fwrite(&count, 8, 1, out) != 1) {
+        return false;
+    }
+    std::vector<unsigned char> buf(trace_record_size * trace.size());
+    auto* p = buf.data();
+    for (const auto& op : trace) {
+        *p = op.op;
+        std::memcpy(p + 1, &op.slot, 4);
+        std::memcpy(p + 5, &op.size, 4);
+        p += trace_record_size;
+    }
+    return std::fwrite(buf.data(), 1, buf.size(), out) == buf.size();
+}
+
+// Whether `trace` keeps the rules of the file format above.
+inline bool valid_trace(const std::vector<trace_op>& trace) {
+    std::vector<bool> live(trace.size());
+    for (const auto& op : trace) {
+        if (op.slot >= trace.size() ||
+            live[op.slot] != (op.op != trace_op::alloc) ||
+            (op.op == trace_op::realloc && op.size == 0)) {
+            return false;
+        }
+        live[op.slot] = op.op != trace_op::free;
+    }
+    return true;
+}
+
+// nullopt if the file is not a trace, is truncated or breaks its rules.
+inline std::optional<std::vector<trace_op>> read_trace(std::FILE* in) {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t count;
+    if (std::fread(magic, 1, 4, in) != 4 ||
+        std::memcmp(magic, trace_magic, 4) != 0 ||
+        std::fread(&version, 4, 1, in) != 1 || version != trace_version ||
+        std::fread(&count, 8, 1, in) != 1) {
+        return std::nullopt;
+    }
+    // `count` is not trusted with an allocation up front: records are read
+    // in chunks, so a corrupt count fails at the end of the data.
+    constexpr std::uint64_t chunk = 1 << 16;
+    std::vector<trace_op> trace;
+    std::vector<unsigned char> buf;
+    for (std::uint64_t left = count; left > 0;) {
+        const auto n = static_cast<size_t>(std::min(left, chunk));
+        buf.resize(trace_record_size * n);
+        if (std::fread(buf.data(), 1, buf.size(), in) != buf.size()) {
+            return std::nullopt;
+        }
+        for (const auto* p = buf.data(); p != buf.data() + buf.size();
+             p += trace_record_size) {
+            if (*p > trace_op::realloc) {
+                return std::nullopt;
+            }
+            trace_op op;
+            op.op = static_cast<trace_op::kind>(*p);
+            std::memcpy(&op.slot, p + 1, 4);
+            std::memcpy(&op.size, p + 5, 4);
+            trace.push_back(op);
+        }
+        left -= n;
+    }
+    if (!valid_trace(trace)) {
+        return std::nullopt;
+    }
+    return trace;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+// Fraction-free (Bareiss) elimination for integer matrices.
+//
+// gaussian_elimination() on integers divides with truncation, so its row
+// echelon form, rank and determinant are wrong as soon as a multiplier is
+// not integral. Bareiss' elimination instead updates
+//
+//     A[i][j] = (A[h][k] * A[i][j] - A[i][k] * A[h][j]) / p
+//
+// where p is the previous pivot. The division is exact and every entry is a
+// minor of the input, so values stay bounded by the determinant instead of
+// growing exponentially. The products are formed in a type twice as wide as
+// T, the exact division is a multiplication by the inverse of the pivot's
+// odd part (no hardware division in the inner loop), and every result is
+// checked to fit T; std::overflow_error is thrown otherwise.
+
+#include "dense_matrix.hpp"
+#include "gaussian_elimination.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+template <std::signed_integral T>
+struct bareiss_result {
+    size_t rank = 0;
+    // Zero unless the matrix is square and of full rank.
+    T determinant = 0;
+};
+
+namespace detail {
+template <size_t Bytes>
+struct bareiss_wide;
+template <>
+struct bareiss_wide<4> {
+    using type = std::int64_t;
+    using unsigned_type = std::uint64_t;
+};
+template <>
+struct bareiss_wide<8> {
+    using type = __int128;
+    using unsigned_type = unsigned __int128;
+};
+
+// x / d for x known to be a multiple of d: d = odd * 2^shift, and odd is
+// invertible modulo 2^N, so x / d = (x >> shift) * odd^-1 mod 2^N.
+template <typename W, typename U>
+class exact_divisor {
+   public:
+    explicit exact_divisor(W d) {
+        assert(d != 0);
+        while (((d >> _shift) & 1) == 0) {
+            ++_shift;
+        }
+        const U u = static_cast<U>(d >> _shift);
+        _inverse = u;  // correct to 3 bits, doubling with each step
+        for (int bits = 3; bits < int(sizeof(U) * 8); bits *= 2) {
+            _inverse *= 2 - u * _inverse;
+        }
+    }
+
+    W divide(W x) const {
+        return static_cast<W>(static_cast<U>(x >> _shift) * _inverse);
+    }
+
+   private:
+    int _shift = 0;
+    U _inverse = 1;
+};
+
+// Bareiss elimination on rows reached through row(i), swapped with
+// swap_rows(a, b).
+template <typename T, typename Row, typename Swap>
+bareiss_result<T> bareiss(size_t row_count, size_t col_count, Row&& row,
+                          Swap&& swap_rows) {
+    using wide = bareiss_wide<std::max<size_t>(sizeof(T), 4)>;
+    using W = typename wide::type;
+    using U = typename wide::unsigned_type;
+
+    W previous = 1;
+    bool negated = false;
+    size_t h = 0;  // row
+    size_t k = 0;  // col
+    for (; h < row_count && k < col_count; ++k) {
+        size_t i_pivot = h;
+        while (i_pivot < row_count && row(i_pivot)[k] == 0) {
+            ++i_pivot;
+        }
+        if (i_pivot == row_count) {
+            continue;
+        }
+        if (i_pivot != h) {
+            swap_rows(h, i_pivot);
+            negated = !negated;
+        }
+
+        const T* pivot_row = row(h);
+        const W pivot = pivot_row[k];
+        const exact_divisor<W, U> divisor{previous};
+        for (size_t i = h + 1; i < row_count; ++i) {
+            T* r = row(i);
+            const W f = r[k];
+            for (size_t j = k + 1; j < col_count; ++j) {
+                const W q = divisor.divide(pivot * r[j] - f * pivot_row[j]);
+                if (q < std::numeric_limits<T>::min() ||
+                    q > std::numeric_limits<T>::max()) {
+                    throw std::overflow_error(
+                        "bareiss_elimination: minor does not fit the type");
+                }
+                r[j] = static_cast<T>(q);
+            }
+            r[k] = 0;
+        }
+        previous = pivot;
+        ++h;
+    }
+
+    bareiss_result<T> result{.rank = h};
+    if (row_count == col_count && h == row_count && h > 0) {
+        const T last = row(h - 1)[h - 1];
+        if (negated && last == std::numeric_limits<T>::min()) {
+            throw std::overflow_error(
+                "bareiss_elimination: determinant does not fit the type");
+        }
+        result.determinant = negated ? static_cast<T>(-last) : last;
+    }
+    return result;
+}
+}  // namespace detail
+
+// Brings A to a fraction-free row echelon form in place. The last pivot of
+// a square matrix of full rank is its determinant, up to the sign of the
+// row swaps.
+template <std::signed_integral T>
+bareiss_result<T> bareiss_elimination(matrix<T>& A) {
+    const size_t col_count = A.empty() ? 0 : A[0].size();
+    return detail::bareiss<T>(
+        A.size(), col_count, [&](size_t i) { return A[i].data(); },
+        [&](size_t a, size_t b) { std::swap(A[a], A[b]); });
+}
+
+template <std::signed_integral T>
+bareiss_result<T> bareiss_elimination(matrix_view<T> A) {
+    return detail::bareiss<T>(
+        A.rows(), A.cols(), [&](size_t i) { return A[i]; },
+        [&](size_t a, size_t b) { A.swap_rows(a, b); });
+}
@@ -0,0 +1,572 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <unistd.h>
+#define BUDDY_HAS_MMAP 1
+#endif
+
+// Define BUDDY_TRACE to print every allocate/free, or define
+// BUDDY_TRACE_PRINT(fmt, args...) to send the trace somewhere else. Without
+// either the trace compiles to nothing.
+#ifndef BUDDY_TRACE_PRINT
+#ifdef BUDDY_TRACE
+#define BUDDY_TRACE_PRINT(...) fmt::print(__VA_ARGS__)
+#else
+#define BUDDY_TRACE_PRINT(...)
+#endif
+#endif
+
+constexpr size_t order_of(size_t v) {
+    return sizeof(size_t) * CHAR_BIT - 1 - std::countl_zero(v);
+}
+
+struct buddy_options {
+    // Reserve the arena with an anonymous mmap instead of a zero-filled
+    // std::vector: startup does not touch the memory and pages are only
+    // committed when first written. Falls back to the vector where mmap is
+    // not available.
+    bool use_mmap = false;
+    // Ask for transparent huge pages (MADV_HUGEPAGE); mmap only.
+    bool huge_pages = false;
+    // When a free coalesces into a block of at least this many bytes, the
+    // block's pages are returned to the OS (MADV_DONTNEED); mmap only, 0
+    // disables. The first page of the block stays, it holds the free list
+    // links.
+    size_t decommit_bytes = 2 << 20;
+};
+
+// Snapshot of a buddy arena's counters, see buddy<>::stats().
+struct buddy_stats {
+    size_t min_order = 0;
+    size_t arena_bytes = 0;
+    size_t live_bytes = 0;  // In allocated blocks, i.e. rounded up.
+    size_t high_water_bytes = 0;
+    size_t free_bytes = 0;
+    size_t largest_free_block = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+    std::uint64_t failed_allocations = 0;
+    std::uint64_t in_place_reallocations = 0;
+    std::uint64_t copied_reallocations = 0;
+    // Index i is order min_order + i.
+    std::vector<size_t> live_blocks;
+    std::vector<size_t> free_blocks;
+    // Bucket b counts requests of (2^(b-1), 2^b] bytes, so a request lands
+    // in the bucket of the order it needs; bucket 0 holds 0 and 1.
+    std::array<std::uint64_t, 65> size_histogram{};
+
+    // Share of the free memory that cannot be handed out as one block:
+    // 0 when all of it is a single block, close to 1 when it is scattered.
+    double external_fragmentation() const noexcept {
+        return free_bytes ? 1.0 - static_cast<double>(largest_free_block) /
+                                      static_cast<double>(free_bytes)
+                          : 0.0;
+    }
+};
+
+// Writes `s` as one JSON object, without a trailing newline. Only non-empty
+// orders and histogram buckets are listed.
+inline void write_json(std::FILE* out, const buddy_stats& s) {
+    fmt::print(out,
+               "{{\"arena_bytes\":{},\"live_bytes\":{},"
+               "\"high_water_bytes\":{},\"free_bytes\":{},"
+               "\"largest_free_block\":{},\"external_fragmentation\":{:.4f},"
+               "\"allocations\":{},\"frees\":{},\"failed_allocations\":{},"
+               "\"in_place_reallocations\":{},\"copied_reallocations\":{},"
+               "\"orders\":[",
+               s.arena_bytes, s.live_bytes, s.high_water_bytes, s.free_bytes,
+               s.largest_free_block, s.external_fragmentation(),
+               s.allocations, s.frees, s.failed_allocations,
+               s.in_place_reallocations, s.copied_reallocations);
+    const char* sep = "";
+    for (size_t i = 0; i < s.live_blocks.size(); ++i) {
+        if (s.live_blocks[i] || s.free_blocks[i]) {
+            fmt::print(out,
+                       "{}{{\"block_bytes\":{},\"live_blocks\":{},"
+                       "\"free_blocks\":{}}}",
+                       sep, size_t{1} << (s.min_order + i), s.live_blocks[i],
+                       s.free_blocks[i]);
+            sep = ",";
+        }
+    }
+    fmt::print(out, "],\"size_histogram\":[");
+    sep = "";
+    for (size_t b = 0; b < s.size_histogram.size(); ++b) {
+        if (s.size_histogram[b]) {
+            fmt::print(out, "{}{{\"max_bytes\":{},\"count\":{}}}", sep,
+                       b < 64 ? size_t{1} << b : SIZE_MAX,
+                       s.size_histogram[b]);
+            sep = ",";
+        }
+    }
+    fmt::print(out, "]}}");
+}
+
+template <size_t Min, size_t Max>
+struct buddy {
+    static_assert(std::has_single_bit(Min) && std::has_single_bit(Max));
+    static_assert(Min <= Max);
+
+    static constexpr size_t MinOrder = order_of(Min);
+    static constexpr size_t MaxOrder = order_of(Max);
+    static constexpr size_t OrderCount = MaxOrder - MinOrder + 1;
+    static constexpr size_t LeafCount = Max / Min;
+
+    // Free blocks are kept in one intrusive, doubly linked list per order;
+    // the links live in the first bytes of the free block itself.
+    struct free_block {
+        free_block* prev;
+        free_block* next;
+    };
+    static_assert(Min >= sizeof(free_block));
+    static_assert(OrderCount <= 64);
+
+    // One byte per Min-sized leaf, meaningful only for the first leaf of a
+    // block: whether the block is free or allocated and its order (relative
+    // to MinOrder). 0 for leaves that do not start a block.
+    using block_info = std::uint8_t;
+    static constexpr block_info free_bit = 0x80;
+    static constexpr block_info allocated_bit = 0x40;
+    static constexpr block_info order_mask = 0x3f;
+
+    buddy(size_t total_sz, const buddy_options& opts = {}) : _size{total_sz} {
+        assert(total_sz >= Min);
+        assert(total_sz <= Max);
+        if (!(opts.use_mmap && map(opts))) {
+            _heap.resize(total_sz);
+            _base = _heap.data();
+        }
+        _blocks.resize(LeafCount);
+        reset();
+    }
+
+    ~buddy() {
+#ifdef BUDDY_HAS_MMAP
+        if (_mapping) {
+            munmap(_mapping, _mapping_size);
+        }
+#endif
+    }
+
+    buddy(const buddy&) = delete;
+    buddy& operator=(const buddy&) = delete;
+
+    void destroy() { reset(); }
+
+    std::byte* base_pointer() noexcept { return _base; }
+    std::byte* end_pointer() noexcept { return _base + _size; }
+
+    void* allocate(size_t sz, [[maybe_unused]] std::string_view label = {}) {
+        ++_size_histogram[sz ? std::bit_width(sz - 1) : 0];
+        size_t next_p2 = std::bit_ceil(sz);
+        size_t order = order_of(next_p2);
+        order = std::max(order, MinOrder);
+        BUDDY_TRACE_PRINT("allocate({}: sz={}, o={})\n", label, next_p2,
+                          order);
+        if (sz > Max) {
+            // Cannot allocate more than the max block size.
+            ++_failed_allocations;
+            return nullptr;
+        }
+
+        void* p = do_allocate(order);
+        _failed_allocations += p == nullptr;
+        return p;
+    }
+
+    void free(void* ptr, [[maybe_unused]] std::string_view label = {}) {
+        BUDDY_TRACE_PRINT("free({}: p={:p}, [{:p}, {:p}])\n", label, ptr,
+                          (void*)base_pointer(), (void*)end_pointer());
+        if (ptr < base_pointer() || ptr >= end_pointer()) {
+            assert(!"invalid pointer (out of managed memory)");
+            return;
+        }
+        [[maybe_unused]] bool ok = do_free(static_cast<std::byte*>(ptr));
+        assert(ok);
+        if (!ok) {
+            fmt::print("could not free pointer {:p}\n", ptr);
+        }
+    }
+
+    // Resizes the block at `ptr` like realloc(). Shrinking splits the tail
+    // off into free blocks. Growing merges the following buddies when they
+    // are all free; only if they are not is a new block allocated and the
+    // old one copied and freed. Returns nullptr, leaving `ptr` untouched, if
+    // there is no room.
+    void* reallocate(void* ptr, size_t new_size,
+                     [[maybe_unused]] std::string_view label = {}) {
+        BUDDY_TRACE_PRINT("reallocate({}: p={:p}, sz={})\n", label, ptr,
+                          new_size);
+        if (!ptr) {
+            return allocate(new_size, label);
+        }
+        const size_t order = allocated_order(ptr);
+        assert(order != 0);
+        ++_size_histogram[new_size ? std::bit_width(new_size - 1) : 0];
+        if (order == 0 || new_size > Max) {
+            ++_failed_allocations;
+            return nullptr;
+        }
+
+        const size_t new_order =
+            std::max(order_of(std::bit_ceil(new_size)), MinOrder);
+        auto* p = static_cast<std::byte*>(ptr);
+        if (new_order <= order) {
+            shrink(p, order, new_order);
+            ++_in_place_reallocations;
+            return p;
+        }
+        if (grow(p, order, new_order)) {
+            ++_in_place_reallocations;
+            return p;
+        }
+
+        void* q = do_allocate(new_order);
+        if (!q) {
+            ++_failed_allocations;
+            return nullptr;
+        }
+        std::memcpy(q, p, size_of_order(order));
+        do_free(p);
+        ++_copied_reallocations;
+        return q;
+    }
+
+    // Order of the allocated block starting at `ptr`, 0 if there is none.
+    // Only reads the block's own metadata byte, which nobody else writes
+    // while the block is allocated, so the owner may call it unlocked.
+    size_t allocated_order(const void* ptr) const noexcept {
+        auto offset = static_cast<const std::byte*>(ptr) - _base;
+        if (offset < 0 || static_cast<size_t>(offset) >= _size ||
+            offset % Min != 0) {
+            return 0;
+        }
+        auto info = _blocks[offset / Min];
+        return (info & allocated_bit) ? MinOrder + (info & order_mask) : 0;
+    }
+
+    // Cheap counters kept on every operation. Live and free counts describe
+    // the current state, the rest accumulates over the arena's lifetime
+    // (destroy() does not clear it).
+    buddy_stats stats() const {
+        buddy_stats s;
+        s.min_order = MinOrder;
+        s.arena_bytes = _size;
+        s.live_bytes = _live_bytes;
+        s.high_water_bytes = _high_water_bytes;
+        s.free_bytes = _free_bytes;
+        if (_non_empty) {
+            s.largest_free_block =
+                size_of_order(MinOrder + std::bit_width(_non_empty) - 1);
+        }
+        s.allocations = _allocations;
+        s.frees = _frees;
+        s.failed_allocations = _failed_allocations;
+        s.in_place_reallocations = _in_place_reallocations;
+        s.copied_reallocations = _copied_reallocations;
+        s.live_blocks.assign(_live_blocks.begin(), _live_blocks.end());
+        s.free_blocks.assign(_free_blocks.begin(), _free_blocks.end());
+        s.size_histogram = _size_histogram;
+        return s;
+    }
+
+    void print(void* ptr = nullptr) {
+        fmt::print("{:p}, [\n", ptr);
+        for (size_t leaf = 0; leaf < LeafCount;) {
+            auto info = _blocks[leaf];
+            if (info == 0) {
+                ++leaf;  // Past the end of a smaller arena.
+                continue;
+            }
+            auto rel_order = info & order_mask;
+            if (info & allocated_bit) {
+                fmt::print("{:>{}}- order={} offset={}\n", "",
+                           OrderCount - 1 - rel_order, rel_order, leaf * Min);
+            }
+            leaf += size_t{1} << rel_order;
+        }
+        fmt::print("]\n");
+    }
+
+   private:
+    static constexpr size_t size_of_order(size_t order) noexcept {
+        return size_t{1} << order;
+    }
+
+    static constexpr block_info free_info(size_t order) noexcept {
+        return static_cast<block_info>(free_bit | (order - MinOrder));
+    }
+
+    static constexpr block_info allocated_info(size_t order) noexcept {
+        return static_cast<block_info>(allocated_bit | (order - MinOrder));
+    }
+
+    size_t leaf_of(const std::byte* p) noexcept {
+        return static_cast<size_t>(p - base_pointer()) / Min;
+    }
+
+    // Carves the arena into the largest aligned free blocks that fit, which
+    // is a single MaxOrder block unless the arena is smaller than Max.
+    void reset() {
+        if (_decommit_order) {
+            decommit(_base, _size);
+        }
+        _free_lists = {};
+        _non_empty = 0;
+        _free_blocks = {};
+        _live_blocks = {};
+        _free_bytes = 0;
+        _live_bytes = 0;
+        std::ranges::fill(_blocks, block_info{0});
+
+        size_t offset = 0;
+        for (size_t order = MaxOrder; order + 1 > MinOrder; --order) {
+            if (offset + size_of_order(order) <= _size) {
+                push(order, base_pointer() + offset);
+                offset += size_of_order(order);
+            }
+        }
+    }
+
+    // Reserves the arena with mmap, aligned to the huge page size if huge
+    // pages were requested so that whole blocks can be backed by them.
+    bool map([[maybe_unused]] const buddy_options& opts) {
+#ifdef BUDDY_HAS_MMAP
+        constexpr size_t huge_page = 2 << 20;
+        _page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t align = opts.huge_pages ? huge_page : 0;
+        _mapping_size =
+            (_size + _page_size - 1) / _page_size * _page_size + align;
+        _mapping = mmap(nullptr, _mapping_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (_mapping == MAP_FAILED) {
+            _mapping = nullptr;
+            return false;
+        }
+
+        auto addr = reinterpret_cast<std::uintptr_t>(_mapping);
+        if (align) {
+            addr = (addr + align - 1) / align * align;
+        }
+        _base = reinterpret_cast<std::byte*>(addr);
+        if (opts.huge_pages) {
+            madvise(_base, _size, MADV_HUGEPAGE);
+        }
+        if (opts.decommit_bytes) {
+            // Blocks must be larger than the page that stays committed, and
+            // span whole huge pages if those are used (the kernel splits a
+            // huge page to drop all but its first small page).
+            _decommit_order =
+                std::max({order_of(std::bit_ceil(opts.decommit_bytes)),
+                          order_of(_page_size) + 1,
+                          opts.huge_pages ? order_of(huge_page) : 0});
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Returns the pages of [p, p + size) to the OS, except the first one.
+    void decommit([[maybe_unused]] std::byte* p,
+                  [[maybe_unused]] size_t size) noexcept {
+#ifdef BUDDY_HAS_MMAP
+        if (size > _page_size) {
+            madvise(p + _page_size, size - _page_size, MADV_DONTNEED);
+        }
+#endif
+    }
+
+    void push(size_t order, std::byte* p) noexcept {
+        auto* b = reinterpret_cast<free_block*>(p);
+        auto& head = _free_lists[order - MinOrder];
+        b->prev = nullptr;
+        b->next = head;
+        if (head) {
+            head->prev = b;
+        }
+        head = b;
+        _non_empty |= uint64_t{1} << (order - MinOrder);
+        _blocks[leaf_of(p)] = free_info(order);
+        ++_free_blocks[order - MinOrder];
+        _free_bytes += size_of_order(order);
+    }
+
+    void unlink(size_t order, free_block* b) noexcept {
+        auto& head = _free_lists[order - MinOrder];
+        if (b->prev) {
+            b->prev->next = b->next;
+        } else {
+            head = b->next;
+        }
+        if (b->next) {
+            b->next->prev = b->prev;
+        }
+        if (!head) {
+            _non_empty &= ~(uint64_t{1} << (order - MinOrder));
+        }
+        --_free_blocks[order - MinOrder];
+        _free_bytes -= size_of_order(order);
+    }
+
+    void* do_allocate(size_t order) {
+        assert(order >= MinOrder && order <= MaxOrder);
+
+        // Smallest non-empty free list of at least `order`.
+        auto candidates = _non_empty >> (order - MinOrder);
+        if (candidates == 0) {
+            return nullptr;
+        }
+        size_t found = order + std::countr_zero(candidates);
+
+        auto* b = _free_lists[found - MinOrder];
+        unlink(found, b);
+        auto* p = reinterpret_cast<std::byte*>(b);
+
+        // Split until the block has the requested order, keeping the lower
+        // half and returning the upper one to its free list.
+        while (found > order) {
+            --found;
+            push(found, p + size_of_order(found));
+        }
+        _blocks[leaf_of(p)] = allocated_info(order);
+        ++_allocations;
+        ++_live_blocks[order - MinOrder];
+        _live_bytes += size_of_order(order);
+        _high_water_bytes = std::max(_high_water_bytes, _live_bytes);
+        return p;
+    }
+
+    // Splits the allocated block at `p` down to `new_order`, returning the
+    // upper halves to the free lists. Their buddies are the part that stays
+    // allocated, so there is nothing to coalesce.
+    void shrink(std::byte* p, size_t order, size_t new_order) {
+        for (size_t o = order; o > new_order;) {
+            --o;
+            push(o, p + size_of_order(o));
+            if (_decommit_order && o >= _decommit_order) {
+                decommit(p + size_of_order(o), size_of_order(o));
+            }
+        }
+        set_allocated_order(p, order, new_order);
+    }
+
+    // Extends the allocated block at `p` to `new_order` in place. Possible if
+    // `p` is aligned to the new size and, for every order on the way, the
+    // upper buddy is one free block of that order.
+    bool grow(std::byte* p, size_t order, size_t new_order) {
+        const auto offset = static_cast<size_t>(p - base_pointer());
+        if (offset % size_of_order(new_order) != 0 ||
+            offset + size_of_order(new_order) > _size) {
+            return false;
+        }
+        for (size_t o = order; o < new_order; ++o) {
+            if (_blocks[(offset + size_of_order(o)) / Min] != free_info(o)) {
+                return false;
+            }
+        }
+        for (size_t o = order; o < new_order; ++o) {
+            auto* b = p + size_of_order(o);
+            unlink(o, reinterpret_cast<free_block*>(b));
+            _blocks[leaf_of(b)] = 0;
+        }
+        set_allocated_order(p, order, new_order);
+        return true;
+    }
+
+    void set_allocated_order(std::byte* p, size_t order,
+                             size_t new_order) noexcept {
+        _blocks[leaf_of(p)] = allocated_info(new_order);
+        --_live_blocks[order - MinOrder];
+        ++_live_blocks[new_order - MinOrder];
+        _live_bytes -= size_of_order(order);
+        _live_bytes += size_of_order(new_order);
+        _high_water_bytes = std::max(_high_water_bytes, _live_bytes);
+    }
+
+    bool do_free(std::byte* p) {
+        const auto offset = static_cast<size_t>(p - base_pointer());
+        if (offset % Min != 0) {
+            return false;
+        }
+        auto info = _blocks[offset / Min];
+        if (!(info & allocated_bit)) {
+            return false;  // Not the start of an allocated block.
+        }
+
+        size_t order = MinOrder + (info & order_mask);
+        size_t block_offset = offset;
+        ++_frees;
+        --_live_blocks[order - MinOrder];
+        _live_bytes -= size_of_order(order);
+        // The freed block's pages are the only committed ones in the merged
+        // block (free blocks of at least _decommit_order have already been
+        // decommitted), so only the block of that order containing them needs
+        // to go.
+        const bool decommit_own = _decommit_order && order >= _decommit_order;
+        // Merge with the buddy as long as it is a free block of the same
+        // order.
+        while (order < MaxOrder) {
+            size_t buddy_offset = block_offset ^ size_of_order(order);
+            if (buddy_offset + size_of_order(order) > _size ||
+                _blocks[buddy_offset / Min] != free_info(order)) {
+                break;
+            }
+            auto* b =
+                reinterpret_cast<free_block*>(base_pointer() + buddy_offset);
+            unlink(order, b);
+            _blocks[buddy_offset / Min] = 0;
+            _blocks[block_offset / Min] = 0;
+            block_offset = std::min(block_offset, buddy_offset);
+            ++order;
+            if (order == _decommit_order) {
+                decommit(base_pointer() + block_offset, size_of_order(order));
+            }
+        }
+        if (decommit_own) {
+            decommit(p, size_of_order(MinOrder + (info & order_mask)));
+        }
+        push(order, base_pointer() + block_offset);
+        return true;
+    }
+
+   private:
+    std::array<free_block*, OrderCount> _free_lists{};
+    uint64_t _non_empty = 0;  // Bit i is set if _free_lists[i] is non-empty.
+    std::vector<block_info> _blocks;
+    std::byte* _base = nullptr;
+    size_t _size = 0;
+    std::vector<std::byte> _heap;  // Backing store unless mmap-ed.
+    void* _mapping = nullptr;
+    size_t _mapping_size = 0;
+    size_t _decommit_order = 0;  // 0: never decommit.
+    size_t _page_size = 0;
+
+    // Telemetry, see stats().
+    std::array<size_t, OrderCount> _free_blocks{};
+    std::array<size_t, OrderCount> _live_blocks{};
+    size_t _free_bytes = 0;
+    size_t _live_bytes = 0;
+    size_t _high_water_bytes = 0;
+    std::uint64_t _allocations = 0;
+    std::uint64_t _frees = 0;
+    std::uint64_t _failed_allocations = 0;
+    std::uint64_t _in_place_reallocations = 0;
+    std::uint64_t _copied_reallocations = 0;
+    std::array<std::uint64_t, 65> _size_histogram{};
+};
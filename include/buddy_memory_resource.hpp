@@ -0,0 +1,77 @@
+#pragma once
+
+// std::pmr::memory_resource over a buddy arena (buddy<> or
+// concurrent_buddy<>), so that pmr containers can allocate from it.
+//
+// Blocks are naturally aligned relative to the arena base, so an alignment
+// up to the base's own alignment is met by rounding the request up to at
+// least `alignment` bytes. Requests the arena cannot serve -- too large, too
+// strictly aligned or arena exhausted -- go to the upstream resource, which
+// by default is null_memory_resource() and thus throws std::bad_alloc.
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+template <typename Arena>
+class buddy_memory_resource : public std::pmr::memory_resource {
+   public:
+    explicit buddy_memory_resource(
+        Arena& arena,
+        std::pmr::memory_resource* upstream = std::pmr::null_memory_resource())
+        : _arena{arena}, _upstream{upstream} {}
+
+    buddy_memory_resource(const buddy_memory_resource&) = delete;
+    buddy_memory_resource& operator=(const buddy_memory_resource&) = delete;
+
+    Arena& arena() const noexcept { return _arena; }
+    std::pmr::memory_resource* upstream_resource() const noexcept {
+        return _upstream;
+    }
+
+    // Number of allocations that were passed to the upstream resource.
+    size_t fallback_count() const noexcept {
+        return _fallbacks.load(std::memory_order_relaxed);
+    }
+
+   protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if (alignment <= base_alignment()) {
+            if (void* p = _arena.allocate(std::max(bytes, alignment))) {
+                return p;
+            }
+        }
+        _fallbacks.fetch_add(1, std::memory_order_relaxed);
+        return _upstream->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        if (owns(p)) {
+            _arena.free(p);
+        } else {
+            _upstream->deallocate(p, bytes, alignment);
+        }
+    }
+
+    bool do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+   private:
+    bool owns(const void* p) const noexcept {
+        return p >= _arena.base_pointer() && p < _arena.end_pointer();
+    }
+
+    size_t base_alignment() const noexcept {
+        auto base = reinterpret_cast<std::uintptr_t>(_arena.base_pointer());
+        return size_t{1} << std::countr_zero(base);
+    }
+
+    Arena& _arena;
+    std::pmr::memory_resource* _upstream;
+    std::atomic<size_t> _fallbacks{0};
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+// Thread-safe front-end for buddy<Min, Max>.
+//
+// The arena itself is guarded by a single mutex. In front of it every thread
+// keeps a magazine (a small stack of blocks) per order: allocate pops from it
+// and free pushes to it without any synchronization. Only when a magazine runs
+// empty or full is the arena locked, to refill or drain half a magazine in
+// one batch. The memory parked in caches is bounded by
+// cache_bytes_per_order per order and thread; orders whose blocks exceed it
+// bypass the cache. A thread's caches are given back to the arena when the
+// thread exits, and dropped if the arena is destroyed first.
+
+#include <fmt/format.h>
+
+#include "buddy_allocator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+template <size_t Min, size_t Max>
+class concurrent_buddy {
+   public:
+    using arena_type = buddy<Min, Max>;
+    static constexpr size_t MinOrder = arena_type::MinOrder;
+    static constexpr size_t MaxOrder = arena_type::MaxOrder;
+    static constexpr size_t OrderCount = arena_type::OrderCount;
+    static constexpr size_t MaxMagazine = 64;
+
+    explicit concurrent_buddy(size_t total_sz,
+                              size_t cache_bytes_per_order = 256 << 10)
+        : _shared{std::make_shared<shared_arena>(total_sz)} {
+        for (size_t order = MinOrder; order <= MaxOrder; ++order) {
+            _capacity[order - MinOrder] = std::min(
+                MaxMagazine, cache_bytes_per_order / (size_t{1} << order));
+        }
+    }
+
+    concurrent_buddy(const concurrent_buddy&) = delete;
+    concurrent_buddy& operator=(const concurrent_buddy&) = delete;
+
+    void* allocate(size_t sz) {
+        if (sz > Max) {
+            return nullptr;
+        }
+        size_t order = std::max(order_of(std::bit_ceil(sz)), MinOrder);
+        const auto capacity = _capacity[order - MinOrder];
+        if (capacity == 0) {
+            std::lock_guard lock{_shared->mutex};
+            return _shared->arena.allocate(sz);
+        }
+
+        auto& cache = local_cache();
+        auto& m = cache.magazines[order - MinOrder];
+        if (m.count == 0) {
+            refill(order, cache, capacity);
+            if (m.count == 0) {
+                return nullptr;
+            }
+        }
+        return m.blocks[--m.count];
+    }
+
+    void free(void* ptr) {
+        if (!ptr) {
+            return;
+        }
+        size_t order = _shared->arena.allocated_order(ptr);
+        if (order == 0) {
+            assert(!"invalid pointer (not an allocated block)");
+            fmt::print("could not free pointer {:p}\n", ptr);
+            return;
+        }
+        const auto capacity = _capacity[order - MinOrder];
+        if (capacity == 0) {
+            std::lock_guard lock{_shared->mutex};
+            _shared->arena.free(ptr);
+            return;
+        }
+
+        auto& m = local_cache().magazines[order - MinOrder];
+        if (m.count == capacity) {
+            drain(m, capacity / 2);
+        }
+        m.blocks[m.count++] = ptr;
+    }
+
+    // Returns all blocks cached by the calling thread to the arena.
+    void flush_thread_cache() {
+        auto& cache = local_cache();
+        std::lock_guard lock{_shared->mutex};
+        release(_shared->arena, cache);
+    }
+
+    std::byte* base_pointer() noexcept {
+        return _shared->arena.base_pointer();
+    }
+    std::byte* end_pointer() noexcept { return _shared->arena.end_pointer(); }
+
+    // The arena's counters; blocks parked in thread caches count as live.
+    buddy_stats stats() {
+        std::lock_guard lock{_shared->mutex};
+        return _shared->arena.stats();
+    }
+
+   private:
+    struct magazine {
+        std::array<void*, MaxMagazine> blocks;
+        size_t count = 0;
+    };
+
+    struct alignas(64) thread_cache {
+        std::array<magazine, OrderCount> magazines;
+    };
+
+    // The part of the arena that a thread's caches outlive it by: they hold
+    // it weakly, to drain into it when the thread exits.
+    struct shared_arena {
+        explicit shared_arena(size_t total_sz) : arena{total_sz} {}
+
+        std::mutex mutex;
+        arena_type arena;
+    };
+
+    struct cache_entry {
+        std::uint64_t id;
+        std::weak_ptr<shared_arena> owner;
+        std::unique_ptr<thread_cache> cache;
+    };
+
+    // The calling thread's caches, one per arena it has used. Keyed by a
+    // never-reused arena id, so a new arena at the address of a destroyed
+    // one cannot pick up stale caches.
+    struct thread_caches {
+        std::vector<cache_entry> entries;
+
+        thread_caches() = default;
+        thread_caches(const thread_caches&) = delete;
+        thread_caches& operator=(const thread_caches&) = delete;
+
+        ~thread_caches() {
+            for (auto& e : entries) {
+                if (auto owner = e.owner.lock()) {
+                    std::lock_guard lock{owner->mutex};
+                    release(owner->arena, *e.cache);
+                }
+            }
+        }
+    };
+
+    // Frees every cached block into `arena`, whose mutex the caller holds.
+    static void release(arena_type& arena, thread_cache& cache) {
+        for (auto& m : cache.magazines) {
+            while (m.count > 0) {
+                arena.free(m.blocks[--m.count]);
+            }
+        }
+    }
+
+    // Half-fills an empty magazine. If the arena is out of blocks of this
+    // order, gives the thread's own cached blocks back first so that they
+    // can coalesce, and tries once more.
+    void refill(size_t order, thread_cache& cache, size_t capacity) {
+        auto& m = cache.magazines[order - MinOrder];
+        const size_t size = size_t{1} << order;
+        const size_t batch = (capacity + 1) / 2;
+
+        std::lock_guard lock{_shared->mutex};
+        while (m.count < batch) {
+            void* p = _shared->arena.allocate(size);
+            if (!p) {
+                break;
+            }
+            m.blocks[m.count++] = p;
+        }
+        if (m.count == 0) {
+            release(_shared->arena, cache);
+            if (void* p = _shared->arena.allocate(size)) {
+                m.blocks[m.count++] = p;
+            }
+        }
+    }
+
+    void drain(magazine& m, size_t keep) {
+        std::lock_guard lock{_shared->mutex};
+        while (m.count > keep) {
+            _shared->arena.free(m.blocks[--m.count]);
+        }
+    }
+
+    // On a miss, also forgets the caches of arenas destroyed since; their
+    // blocks went with the arena.
+    thread_cache& local_cache() {
+        thread_local thread_caches caches;
+        for (const auto& e : caches.entries) {
+            if (e.id == _id) {
+                return *e.cache;
+            }
+        }
+
+        std::erase_if(caches.entries,
+                      [](const cache_entry& e) { return e.owner.expired(); });
+        caches.entries.push_back(
+            {_id, _shared, std::make_unique<thread_cache>()});
+        return *caches.entries.back().cache;
+    }
+
+    static std::uint64_t next_id() {
+        static std::atomic<std::uint64_t> id{0};
+        return id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const std::uint64_t _id = next_id();
+    std::array<size_t, OrderCount> _capacity{};
+    std::shared_ptr<shared_arena> _shared;
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+// Directed, weighted graphs in compressed sparse row form.
+//
+// Vertices are the contiguous ids 0 .. vertex_count() - 1. The out-edges of
+// each vertex are contiguous, in source order, as a target array and a
+// parallel weight array, so a pass over all edges reads both front to back.
+//
+// The graph is used through free functions found by argument-dependent
+// lookup: vertices(g), edges(g), out_edges(g, u), and source(e), target(e)
+// on the edge references these return. An edge reference also carries the
+// edge's index into the weight array, see csr_graph::weight().
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <vector>
+
+namespace graph_detail {
+using vertex_id = std::uint32_t;
+
+struct edge_reference {
+    vertex_id source;
+    vertex_id target;
+    size_t index;
+};
+
+inline vertex_id source(const edge_reference& e) noexcept { return e.source; }
+inline vertex_id target(const edge_reference& e) noexcept { return e.target; }
+
+// Walks the edges of all vertices in storage order; the source advances
+// whenever the edge index reaches the start of the next vertex.
+class edge_iterator {
+   public:
+    using value_type = edge_reference;
+    using difference_type = std::ptrdiff_t;
+
+    edge_iterator() = default;
+    edge_iterator(const size_t* starts, const vertex_id* targets,
+                  vertex_id vertex_count, size_t index)
+        : _starts{starts},
+          _targets{targets},
+          _last{vertex_count > 0 ? vertex_count - 1 : 0},
+          _index{index} {
+        if (index < starts[vertex_count]) {
+            skip_empty();
+        }
+    }
+
+    edge_reference operator*() const noexcept {
+        return {_source, _targets[_index], _index};
+    }
+
+    edge_iterator& operator++() noexcept {
+        ++_index;
+        skip_empty();
+        return *this;
+    }
+    edge_iterator operator++(int) noexcept {
+        auto copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    friend bool operator==(const edge_iterator& a,
+                           const edge_iterator& b) noexcept {
+        return a._index == b._index;
+    }
+
+   private:
+    void skip_empty() noexcept {
+        while (_source < _last && _starts[_source + 1] <= _index) {
+            ++_source;
+        }
+    }
+
+    const size_t* _starts = nullptr;
+    const vertex_id* _targets = nullptr;
+    vertex_id _last = 0;
+    vertex_id _source = 0;
+    size_t _index = 0;
+};
+}  // namespace graph_detail
+
+template <typename W>
+class csr_graph {
+   public:
+    using vertex_id = graph_detail::vertex_id;
+    using weight_type = W;
+    using edge_reference = graph_detail::edge_reference;
+
+    struct edge {
+        vertex_id source;
+        vertex_id target;
+        W weight;
+    };
+
+    csr_graph() : _starts(1, 0) {}
+
+    // From edges in any order; parallel edges and loops are kept. Edges of
+    // the same source keep their relative order.
+    csr_graph(size_t vertex_count, std::span<const edge> edges)
+        : _starts(vertex_count + 1, 0),
+          _targets(edges.size()),
+          _weights(edges.size()) {
+        assert(vertex_count < size_t{1} << 32);
+        for (const auto& e : edges) {
+            assert(e.source < vertex_count && e.target < vertex_count);
+            ++_starts[e.source + 1];
+        }
+        std::partial_sum(_starts.begin(), _starts.end(), _starts.begin());
+        std::vector<size_t> next(_starts.begin(), _starts.end() - 1);
+        for (const auto& e : edges) {
+            const size_t i = next[e.source]++;
+            _targets[i] = e.target;
+            _weights[i] = e.weight;
+        }
+    }
+
+    size_t vertex_count() const noexcept { return _starts.size() - 1; }
+    size_t edge_count() const noexcept { return _targets.size(); }
+
+    // Out-edges of u are [starts()[u], starts()[u + 1]).
+    std::span<const size_t> starts() const noexcept { return _starts; }
+    std::span<const vertex_id> targets() const noexcept { return _targets; }
+    std::span<const W> weights() const noexcept { return _weights; }
+
+    W weight(const edge_reference& e) const noexcept {
+        return _weights[e.index];
+    }
+
+    size_t out_degree(vertex_id u) const noexcept {
+        return _starts[u + 1] - _starts[u];
+    }
+
+    friend auto vertices(const csr_graph& g) noexcept {
+        return std::views::iota(vertex_id{0}, vertex_id(g.vertex_count()));
+    }
+
+    friend auto edges(const csr_graph& g) noexcept {
+        const auto n = vertex_id(g.vertex_count());
+        return std::ranges::subrange(
+            graph_detail::edge_iterator(g._starts.data(), g._targets.data(),
+                                        n, 0),
+            graph_detail::edge_iterator(g._starts.data(), g._targets.data(),
+                                        n, g.edge_count()));
+    }
+
+    friend auto out_edges(const csr_graph& g, vertex_id u) noexcept {
+        return std::views::iota(g._starts[u], g._starts[u + 1]) |
+               std::views::transform([u, t = g._targets.data()](size_t i) {
+                   return edge_reference{u, t[i], i};
+               });
+    }
+
+   private:
+    std::vector<size_t> _starts;
+    std::vector<vertex_id> _targets;
+    std::vector<W> _weights;
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+// Contiguous row-major matrix and non-owning views of it.
+//
+// Rows are padded to a stride that is a multiple of the storage alignment,
+// so every row starts on an aligned address and SIMD kernels can use aligned
+// loads on whole rows. A view is a pointer, a shape and a stride; sub-blocks
+// of a view are views again, without copying.
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+template <typename T>
+class matrix_view {
+   public:
+    matrix_view() = default;
+    matrix_view(T* data, size_t rows, size_t cols, size_t stride) noexcept
+        : _data{data}, _rows{rows}, _cols{cols}, _stride{stride} {
+        assert(stride >= cols || rows <= 1);
+    }
+
+    // A view of const elements from a view of mutable ones.
+    template <typename U>
+        requires std::is_same_v<const U, T>
+    matrix_view(const matrix_view<U>& other) noexcept
+        : matrix_view{other.data(), other.rows(), other.cols(),
+                      other.stride()} {}
+
+    T* data() const noexcept { return _data; }
+    size_t rows() const noexcept { return _rows; }
+    size_t cols() const noexcept { return _cols; }
+    size_t stride() const noexcept { return _stride; }
+    bool empty() const noexcept { return _rows == 0 || _cols == 0; }
+
+    // Pointer to row i, so that A[i][j] works as for nested vectors.
+    T* operator[](size_t i) const noexcept {
+        assert(i < _rows);
+        return _data + i * _stride;
+    }
+
+    T& operator()(size_t i, size_t j) const noexcept {
+        assert(j < _cols);
+        return (*this)[i][j];
+    }
+
+    std::span<T> row(size_t i) const noexcept { return {(*this)[i], _cols}; }
+
+    // The rows x cols block starting at (r0, c0).
+    matrix_view block(size_t r0, size_t c0, size_t rows,
+                      size_t cols) const noexcept {
+        assert(r0 + rows <= _rows && c0 + cols <= _cols);
+        return {_data + r0 * _stride + c0, rows, cols, _stride};
+    }
+
+    void swap_rows(size_t a, size_t b) const noexcept {
+        if (a != b) {
+            std::swap_ranges((*this)[a], (*this)[a] + _cols, (*this)[b]);
+        }
+    }
+
+   private:
+    T* _data = nullptr;
+    size_t _rows = 0;
+    size_t _cols = 0;
+    size_t _stride = 0;
+};
+
+// Owning, zero-initialized row-major matrix with Alignment-byte aligned rows.
+template <typename T, size_t Alignment = 64>
+class dense_matrix {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(Alignment % alignof(T) == 0 && Alignment % sizeof(T) == 0);
+
+   public:
+    using value_type = T;
+
+    dense_matrix() = default;
+
+    dense_matrix(size_t rows, size_t cols)
+        : _rows{rows}, _cols{cols}, _stride{padded(cols)} {
+        const size_t n = _rows * _stride;
+        if (n) {
+            _data.reset(static_cast<T*>(::operator new(
+                n * sizeof(T), std::align_val_t{Alignment})));
+            std::memset(static_cast<void*>(_data.get()), 0, n * sizeof(T));
+        }
+    }
+
+    dense_matrix(std::initializer_list<std::initializer_list<T>> rows)
+        : dense_matrix(rows.size(), rows.size() ? rows.begin()->size() : 0) {
+        size_t i = 0;
+        for (const auto& r : rows) {
+            assert(r.size() == _cols);
+            std::ranges::copy(r, (*this)[i++]);
+        }
+    }
+
+    dense_matrix(const dense_matrix& other)
+        : dense_matrix(other._rows, other._cols) {
+        if (_data) {
+            std::memcpy(static_cast<void*>(_data.get()), other._data.get(),
+                        _rows * _stride * sizeof(T));
+        }
+    }
+
+    dense_matrix& operator=(const dense_matrix& other) {
+        if (this != &other) {
+            *this = dense_matrix(other);
+        }
+        return *this;
+    }
+
+    dense_matrix(dense_matrix&&) noexcept = default;
+    dense_matrix& operator=(dense_matrix&&) noexcept = default;
+
+    T* data() noexcept { return _data.get(); }
+    const T* data() const noexcept { return _data.get(); }
+    size_t rows() const noexcept { return _rows; }
+    size_t cols() const noexcept { return _cols; }
+    size_t stride() const noexcept { return _stride; }
+
+    T* operator[](size_t i) noexcept { return view()[i]; }
+    const T* operator[](size_t i) const noexcept { return view()[i]; }
+
+    matrix_view<T> view() noexcept {
+        return {_data.get(), _rows, _cols, _stride};
+    }
+    matrix_view<const T> view() const noexcept {
+        return {_data.get(), _rows, _cols, _stride};
+    }
+    operator matrix_view<T>() noexcept { return view(); }
+    operator matrix_view<const T>() const noexcept { return view(); }
+
+   private:
+    // Rounds up to whole Alignment-sized lines and avoids strides that are
+    // a multiple of 4 KiB, where the same column of consecutive rows would
+    // map to the same cache set and alias in the store buffer.
+    static constexpr size_t padded(size_t cols) noexcept {
+        constexpr size_t per_line = Alignment / sizeof(T);
+        size_t stride = (cols + per_line - 1) / per_line * per_line;
+        if (stride * sizeof(T) % 4096 == 0) {
+            stride += per_line;
+        }
+        return stride;
+    }
+
+    struct aligned_delete {
+        void operator()(T* p) const noexcept {
+            ::operator delete(p, std::align_val_t{Alignment});
+        }
+    };
+
+    std::unique_ptr<T[], aligned_delete> _data;
+    size_t _rows = 0;
+    size_t _cols = 0;
+    size_t _stride = 0;
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+// Small matrices with compile-time dimensions.
+//
+// fixed_matrix<T, R, C> is an aggregate of R rows of std::array<T, C>: no
+// allocation, and the elimination and solver below are constexpr, with every
+// loop over rows and columns unrolled by the compiler.
+//
+// soa_batch<T, N> holds `lanes` N x N systems with entry (i, j) of all of
+// them contiguous (structure of arrays), so that one vector operation acts
+// on the same entry of every system. solve() eliminates all lanes at once
+// with partial pivoting done per lane by comparisons and blends instead of
+// branches. The vectors are GCC vector extensions as wide as the registers of
+// the instruction set (16, 32 or 64 bytes, so a 64-byte batch is solved in
+// 4, 2 or 1 passes), under the same runtime dispatch as the row kernels.
+
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+template <typename T, size_t R, size_t C>
+struct fixed_matrix {
+    static constexpr size_t row_count = R;
+    static constexpr size_t col_count = C;
+
+    std::array<std::array<T, C>, R> rows{};
+
+    constexpr std::array<T, C>& operator[](size_t i) { return rows[i]; }
+    constexpr const std::array<T, C>& operator[](size_t i) const {
+        return rows[i];
+    }
+};
+
+// Loops below run over compile-time bounds and are unrolled completely.
+#define FIXED_MATRIX_UNROLL _Pragma("GCC unroll 16")
+
+namespace detail {
+template <typename T>
+constexpr T fixed_abs(T x) {
+    return x < 0 ? -x : x;
+}
+
+// Swaps rows a < b of a fixed_matrix or entries of an array. Written as a
+// test against every candidate row, so that after unrolling all indices are
+// constants and the matrix can stay in registers.
+template <size_t Rows, typename M>
+constexpr void swap_rows(M& A, size_t a, size_t b) {
+    FIXED_MATRIX_UNROLL
+    for (size_t i = 0; i < Rows; ++i) {
+        if (i == b && i != a) {
+            std::swap(A[a], A[i]);
+        }
+    }
+}
+}  // namespace detail
+
+// Row echelon form with partial pivoting, as gaussian_elimination() for the
+// jagged matrices does it. Returns the rank.
+template <typename T, size_t R, size_t C>
+constexpr size_t gaussian_elimination(fixed_matrix<T, R, C>& A) {
+    size_t h = 0;  // row
+    FIXED_MATRIX_UNROLL
+    for (size_t k = 0; k < C; ++k) {
+        if (h >= R) break;
+        size_t i_max = h;
+        FIXED_MATRIX_UNROLL
+        for (size_t i = 0; i < R; ++i) {
+            if (i > h && detail::fixed_abs(A[i][k]) >
+                             detail::fixed_abs(A[i_max][k])) {
+                i_max = i;
+            }
+        }
+        if (A[i_max][k] == 0) continue;
+        detail::swap_rows<R>(A, h, i_max);
+        FIXED_MATRIX_UNROLL
+        for (size_t i = 0; i < R; ++i) {
+            if (i <= h) continue;
+            const T f = A[i][k] / A[h][k];
+            A[i][k] = 0;
+            FIXED_MATRIX_UNROLL
+            for (size_t j = k + 1; j < C; ++j) {
+                A[i][j] -= A[h][j] * f;
+            }
+        }
+        ++h;
+    }
+    return h;
+}
+
+// x with Ax = b, or nullopt if A is singular.
+template <typename T, size_t N>
+constexpr std::optional<std::array<T, N>> solve(fixed_matrix<T, N, N> A,
+                                                std::array<T, N> b) {
+    FIXED_MATRIX_UNROLL
+    for (size_t k = 0; k < N; ++k) {
+        size_t i_max = k;
+        FIXED_MATRIX_UNROLL
+        for (size_t i = k + 1; i < N; ++i) {
+            if (detail::fixed_abs(A[i][k]) > detail::fixed_abs(A[i_max][k])) {
+                i_max = i;
+            }
+        }
+        if (A[i_max][k] == 0) return std::nullopt;
+        detail::swap_rows<N>(A, k, i_max);
+        detail::swap_rows<N>(b, k, i_max);
+        FIXED_MATRIX_UNROLL
+        for (size_t i = k + 1; i < N; ++i) {
+            const T f = A[i][k] / A[k][k];
+            FIXED_MATRIX_UNROLL
+            for (size_t j = k + 1; j < N; ++j) {
+                A[i][j] -= A[k][j] * f;
+            }
+            b[i] -= b[k] * f;
+        }
+    }
+    FIXED_MATRIX_UNROLL
+    for (size_t r = 0; r < N; ++r) {
+        const size_t i = N - 1 - r;
+        FIXED_MATRIX_UNROLL
+        for (size_t j = i + 1; j < N; ++j) {
+            b[i] -= A[i][j] * b[j];
+        }
+        b[i] /= A[i][i];
+    }
+    return b;
+}
+
+// `lanes` N x N systems Ax = b in structure-of-arrays layout. After solve()
+// b holds the solutions; a lane whose matrix is singular gets infinities or
+// NaNs.
+template <typename T, size_t N>
+struct soa_batch {
+    static_assert(std::is_floating_point_v<T>);
+    static constexpr size_t lanes = 64 / sizeof(T);
+
+    alignas(64) T a[N][N][lanes];
+    alignas(64) T b[N][lanes];
+
+    void set(size_t lane, const fixed_matrix<T, N, N>& A,
+             const std::array<T, N>& rhs) noexcept {
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                a[i][j][lane] = A[i][j];
+            }
+            b[i][lane] = rhs[i];
+        }
+    }
+
+    std::array<T, N> solution(size_t lane) const noexcept {
+        std::array<T, N> x;
+        for (size_t i = 0; i < N; ++i) {
+            x[i] = b[i][lane];
+        }
+        return x;
+    }
+};
+
+namespace detail {
+// Vectors of Bytes / sizeof(T) lanes, and the matching comparison masks.
+template <typename T, size_t Bytes>
+struct lanes_of;
+template <size_t Bytes>
+struct lanes_of<double, Bytes> {
+    typedef double vec __attribute__((vector_size(Bytes)));
+    typedef long long mask __attribute__((vector_size(Bytes)));
+};
+template <size_t Bytes>
+struct lanes_of<float, Bytes> {
+    typedef float vec __attribute__((vector_size(Bytes)));
+    typedef int mask __attribute__((vector_size(Bytes)));
+};
+
+// The batched elimination and back substitution on the Bytes / sizeof(T)
+// lanes starting at lane l0. Always inlined, so that it is compiled for the
+// instruction set of the function it is called from, where Bytes is the
+// register width: wider vectors would not let the matrix stay in registers.
+template <size_t Bytes, typename T, size_t N>
+SIMD_INLINE void solve_lanes(soa_batch<T, N>& s, size_t l0) {
+    using vec = typename lanes_of<T, Bytes>::vec;
+    using ivec = typename lanes_of<T, Bytes>::mask;
+
+    vec a[N][N];
+    vec b[N];
+    FIXED_MATRIX_UNROLL
+    for (size_t i = 0; i < N; ++i) {
+        FIXED_MATRIX_UNROLL
+        for (size_t j = 0; j < N; ++j) {
+            std::memcpy(&a[i][j], &s.a[i][j][l0], sizeof(vec));
+        }
+        std::memcpy(&b[i], &s.b[i][l0], sizeof(vec));
+    }
+
+    FIXED_MATRIX_UNROLL
+    for (size_t k = 0; k < N; ++k) {
+        // Per-lane partial pivoting: row k is swapped, lane by lane, with
+        // every later row whose entry in column k is larger in magnitude, so
+        // that it ends up holding the first largest one.
+        FIXED_MATRIX_UNROLL
+        for (size_t i = k + 1; i < N; ++i) {
+            const vec best = a[k][k] < 0 ? -a[k][k] : a[k][k];
+            const vec v = a[i][k] < 0 ? -a[i][k] : a[i][k];
+            const ivec take = v > best;
+            FIXED_MATRIX_UNROLL
+            for (size_t j = k; j < N; ++j) {
+                const vec t = a[k][j];
+                a[k][j] = take ? a[i][j] : t;
+                a[i][j] = take ? t : a[i][j];
+            }
+            const vec t = b[k];
+            b[k] = take ? b[i] : t;
+            b[i] = take ? t : b[i];
+        }
+
+        const vec inverse = T{1} / a[k][k];
+        FIXED_MATRIX_UNROLL
+        for (size_t i = k + 1; i < N; ++i) {
+            const vec f = a[i][k] * inverse;
+            FIXED_MATRIX_UNROLL
+            for (size_t j = k + 1; j < N; ++j) {
+                a[i][j] -= f * a[k][j];
+            }
+            b[i] -= f * b[k];
+        }
+    }
+
+    FIXED_MATRIX_UNROLL
+    for (size_t r = 0; r < N; ++r) {
+        const size_t i = N - 1 - r;
+        FIXED_MATRIX_UNROLL
+        for (size_t j = i + 1; j < N; ++j) {
+            b[i] -= a[i][j] * b[j];
+        }
+        b[i] /= a[i][i];
+    }
+    FIXED_MATRIX_UNROLL
+    for (size_t i = 0; i < N; ++i) {
+        std::memcpy(&s.b[i][l0], &b[i], sizeof(vec));
+    }
+}
+
+template <typename T, size_t N>
+void solve_portable(soa_batch<T, N>& s) {
+    for (size_t l0 = 0; l0 < s.lanes; l0 += 16 / sizeof(T)) {
+        solve_lanes<16>(s, l0);
+    }
+}
+
+#ifdef SIMD_KERNELS_X86
+template <typename T, size_t N>
+SIMD_AVX2 void solve_avx2(soa_batch<T, N>& s) {
+    for (size_t l0 = 0; l0 < s.lanes; l0 += 32 / sizeof(T)) {
+        solve_lanes<32>(s, l0);
+    }
+}
+
+template <typename T, size_t N>
+SIMD_AVX512 void solve_avx512(soa_batch<T, N>& s) {
+    solve_lanes<64>(s, 0);
+}
+#endif
+}  // namespace detail
+
+// Solves all lanes of the batch in place.
+template <typename T, size_t N>
+void solve(soa_batch<T, N>& s) {
+#ifdef SIMD_KERNELS_X86
+    switch (simd::active_isa()) {
+        case simd::isa::avx512:
+            return detail::solve_avx512(s);
+        case simd::isa::avx2:
+            return detail::solve_avx2(s);
+        case simd::isa::portable:
+            break;
+    }
+#endif
+    detail::solve_portable(s);
+}
+
+// x[m] with A[m] x[m] = b[m] for every m, soa_batch::lanes systems at a
+// time. The last, partial batch is padded with identity systems.
+template <typename T, size_t N>
+void solve_batch(std::span<const fixed_matrix<T, N, N>> A,
+                 std::span<const std::array<T, N>> b,
+                 std::span<std::array<T, N>> x) {
+    constexpr size_t L = soa_batch<T, N>::lanes;
+    fixed_matrix<T, N, N> identity{};
+    for (size_t i = 0; i < N; ++i) {
+        identity[i][i] = 1;
+    }
+    soa_batch<T, N> batch;
+    for (size_t m0 = 0; m0 < A.size(); m0 += L) {
+        const size_t count = std::min(L, A.size() - m0);
+        for (size_t l = 0; l < L; ++l) {
+            if (l < count) {
+                batch.set(l, A[m0 + l], b[m0 + l]);
+            } else {
+                batch.set(l, identity, {});
+            }
+        }
+        solve(batch);
+        for (size_t l = 0; l < count; ++l) {
+            x[m0 + l] = batch.solution(l);
+        }
+    }
+}
+
+#undef FIXED_MATRIX_UNROLL
@@ -0,0 +1,476 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include "dense_matrix.hpp"
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <cassert>
+#include <cstdio>
+#include <limits>
+#include <thread>
+#include <vector>
+
+// Define GAUSSIAN_TRACE to print the matrix after every elimination step.
+#ifdef GAUSSIAN_TRACE
+#define GAUSSIAN_TRACE_PRINT(...) fmt::print(__VA_ARGS__)
+#define GAUSSIAN_TRACE_MATRIX(A) (print(A), fflush(stdout))
+#else
+#define GAUSSIAN_TRACE_PRINT(...)
+#define GAUSSIAN_TRACE_MATRIX(A)
+#endif
+
+template <typename T>
+using matrix = std::vector<std::vector<T>>;
+
+template <typename T>
+void print(const matrix<T>& m) {
+    fmt::print("[\n");
+    for (const auto& r : m) {
+        for (const auto& c : r) {
+            fmt::print("{}, ", c);
+        }
+        fmt::print("\n");
+    }
+    fmt::print("]\n");
+}
+
+template <typename T>
+void print(matrix_view<T> m) {
+    fmt::print("[\n");
+    for (size_t i = 0; i < m.rows(); ++i) {
+        for (const auto& c : m.row(i)) {
+            fmt::print("{}, ", c);
+        }
+        fmt::print("\n");
+    }
+    fmt::print("]\n");
+}
+
+template <typename T>
+size_t find_argmax_abs(const matrix<T>& A, size_t r_min, size_t col) {
+    const auto row_count = A.size();
+    assert(r_min < row_count);
+
+    size_t i_max = r_min;
+    for (size_t i = i_max + 1; i < row_count; ++i) {
+        using std::abs;
+        if (abs(A[i][col]) > abs(A[i_max][col])) {
+            // New max found
+            i_max = i;
+        }
+    }
+    return i_max;
+}
+
+template <typename T>
+size_t find_argmax_abs(matrix_view<T> A, size_t r_min, size_t col) {
+    assert(r_min < A.rows());
+
+    size_t i_max = r_min;
+    for (size_t i = i_max + 1; i < A.rows(); ++i) {
+        using std::abs;
+        if (abs(A[i][col]) > abs(A[i_max][col])) {
+            i_max = i;
+        }
+    }
+    return i_max;
+}
+
+// dst[j] -= src[j] * f for j < n; SIMD for float, double and int32.
+template <typename T>
+void row_update(T* dst, const T* src, T f, size_t n) {
+    if constexpr (simd::has_row_kernels<T>) {
+        simd::row_update(dst, src, f, n);
+    } else {
+        simd::row_update_portable(dst, src, f, n);
+    }
+}
+
+// row_update() with four source rows at once, applied in order, so that dst
+// is loaded and stored once instead of four times.
+template <typename T>
+void row_update4(T* dst, const T* const* src, const T* f, size_t n) {
+    if constexpr (simd::has_row_kernels<T>) {
+        simd::row_update4(dst, src, f, n);
+    } else {
+        simd::row_update4_portable(dst, src, f, n);
+    }
+}
+
+// row_update4() on four destination rows with their own factors f[r].
+template <typename T>
+void row_update4x4(T* const* dst, const T* const* src, const T (*f)[4],
+                   size_t n) {
+    if constexpr (simd::has_row_kernels<T>) {
+        simd::row_update4x4(dst, src, f, n);
+    } else {
+        simd::row_update4x4_portable(dst, src, f, n);
+    }
+}
+
+template <typename T>
+void gaussian_elimination(matrix<T>& A) {
+    const auto row_count = A.size();
+    if (A.empty()) return;
+    const auto col_count = A[0].size();
+    size_t h = 0;  // row
+    size_t k = 0;  // col
+
+    while (h < row_count && k < col_count) {
+        /* Find the k-th pivot: */
+        // size_t i_max := argmax (i = h ... m, abs(A[i, k]))
+        size_t i_max = find_argmax_abs(A, h, k);
+        GAUSSIAN_TRACE_PRINT("h = {}, k = {}, pivot = {}, A[pivot][k] = {}\n",
+                             h, k, i_max, A[i_max][k]);
+        if (A[i_max][k] == 0) {
+            /* No pivot in this column, pass to next column */
+            ++k;
+        } else {
+            // swap rows(h, i_max)
+            using std::swap;
+            swap(A[h], A[i_max]);
+
+            /* Do for all rows below pivot: */
+            for (size_t i = h + 1; i < row_count; ++i) {
+                auto f = A[i][k] / A[h][k];
+                /* Fill with zeros the lower part of pivot column: */
+                A[i][k] = 0;
+                /* Do for all remaining elements in current row: */
+                for (size_t j = k + 1; j < col_count; ++j) {
+                    A[i][j] -= A[h][j] * f;
+                }
+            }
+
+            /* Increase pivot row and column */
+            ++h;
+            ++k;
+        }
+        GAUSSIAN_TRACE_MATRIX(A);
+    }
+}
+
+// The same algorithm on a contiguous matrix.
+template <typename T>
+void gaussian_elimination(matrix_view<T> A) {
+    const auto row_count = A.rows();
+    const auto col_count = A.cols();
+    size_t h = 0;  // row
+    size_t k = 0;  // col
+
+    while (h < row_count && k < col_count) {
+        size_t i_max = find_argmax_abs(A, h, k);
+        if (A[i_max][k] == 0) {
+            ++k;
+            continue;
+        }
+        A.swap_rows(h, i_max);
+        for (size_t i = h + 1; i < row_count; ++i) {
+            auto f = A[i][k] / A[h][k];
+            A[i][k] = 0;
+            row_update(A[i] + k + 1, A[h] + k + 1, f, col_count - k - 1);
+        }
+        ++h;
+        ++k;
+        GAUSSIAN_TRACE_MATRIX(A);
+    }
+}
+
+namespace detail {
+// Subtracts from columns [k0 + j0, k0 + j0 + width) of rows [i0, i1) the
+// pivot rows U scaled by the multipliers stored in the pivot columns: four
+// rows and four pivot rows per kernel call where possible, always subtracting
+// the pivot rows in order.
+template <typename T>
+void update_rows(matrix_view<T> A, matrix_view<T> U,
+                 const std::vector<size_t>& pivot_cols, size_t i0, size_t i1,
+                 size_t k0, size_t j0, size_t width) {
+    const size_t r = pivot_cols.size();
+    size_t i = i0;
+    for (; i + 4 <= i1; i += 4) {
+        T* rows[4];
+        for (size_t q = 0; q < 4; ++q) {
+            rows[q] = A[i + q] + k0 + j0;
+        }
+        size_t t = 0;
+        for (; t + 4 <= r; t += 4) {
+            const T* src[4];
+            T f[4][4];
+            for (size_t p = 0; p < 4; ++p) {
+                src[p] = U[t + p] + j0;
+                for (size_t q = 0; q < 4; ++q) {
+                    f[q][p] = A[i + q][pivot_cols[t + p]];
+                }
+            }
+            row_update4x4(rows, src, f, width);
+        }
+        for (; t < r; ++t) {
+            for (size_t q = 0; q < 4; ++q) {
+                row_update(rows[q], U[t] + j0, A[i + q][pivot_cols[t]],
+                           width);
+            }
+        }
+    }
+    for (; i < i1; ++i) {
+        T* row = A[i] + k0 + j0;
+        size_t t = 0;
+        for (; t + 4 <= r; t += 4) {
+            const T* src[4] = {U[t] + j0, U[t + 1] + j0, U[t + 2] + j0,
+                               U[t + 3] + j0};
+            const T f[4] = {A[i][pivot_cols[t]], A[i][pivot_cols[t + 1]],
+                            A[i][pivot_cols[t + 2]], A[i][pivot_cols[t + 3]]};
+            row_update4(row, src, f, width);
+        }
+        for (; t < r; ++t) {
+            row_update(row, U[t] + j0, A[i][pivot_cols[t]], width);
+        }
+    }
+}
+
+// The elimination behind blocked_gaussian_elimination(). With `pivots` the
+// row swapped into place at each pivot is appended to it, and the
+// multipliers are left below the pivots instead of being zeroed, which for a
+// square matrix of full rank is its PA = LU factorization in LAPACK's layout.
+template <typename T>
+void blocked_elimination(matrix_view<T> A, size_t panel, size_t tile_cols,
+                         std::vector<size_t>* pivots) {
+    const auto row_count = A.rows();
+    const auto col_count = A.cols();
+    assert(panel > 0);
+    if (tile_cols == 0) {
+        tile_cols = std::max<size_t>(64, (128 << 10) / (panel * sizeof(T)));
+    }
+
+    std::vector<size_t> pivot_cols;
+    size_t h = 0;  // row
+    size_t k = 0;  // col
+    while (h < row_count && k < col_count) {
+        const size_t h0 = h;
+        const size_t k_end = std::min(col_count, k + panel);
+        pivot_cols.clear();
+
+        for (; h < row_count && k < k_end; ++k) {
+            size_t i_max = find_argmax_abs(A, h, k);
+            if (A[i_max][k] == 0) {
+                continue;
+            }
+            A.swap_rows(h, i_max);
+            if (pivots) {
+                pivots->push_back(i_max);
+            }
+            for (size_t i = h + 1; i < row_count; ++i) {
+                auto f = A[i][k] / A[h][k];
+                A[i][k] = f;
+                row_update(A[i] + k + 1, A[h] + k + 1, f, k_end - k - 1);
+            }
+            pivot_cols.push_back(k);
+            ++h;
+        }
+
+        const size_t r = pivot_cols.size();
+        const size_t trailing = col_count - k_end;
+        if (r > 0 && trailing > 0) {
+            auto U = A.block(h0, k_end, r, trailing);
+            for (size_t t = 1; t < r; ++t) {
+                for (size_t s = 0; s < t; ++s) {
+                    row_update(U[t], U[s], A[h0 + t][pivot_cols[s]],
+                               trailing);
+                }
+            }
+            for (size_t j0 = 0; j0 < trailing; j0 += tile_cols) {
+                const size_t width = std::min(tile_cols, trailing - j0);
+                detail::update_rows(A, U, pivot_cols, h0 + r, row_count,
+                                    k_end, j0, width);
+            }
+        }
+
+        for (size_t t = 0; t < r && !pivots; ++t) {
+            for (size_t i = h0 + t + 1; i < row_count; ++i) {
+                A[i][pivot_cols[t]] = 0;
+            }
+        }
+        GAUSSIAN_TRACE_MATRIX(A);
+    }
+}
+}  // namespace detail
+
+// Row echelon form like gaussian_elimination(), a panel of `panel` columns
+// at a time. Within the panel the pivots are found and eliminated as usual,
+// but only the panel's columns are updated and the multipliers are kept in
+// place of the zeros. The pivot rows' trailing part is then brought up to
+// date by forward substitution, and the rows below are updated with one
+// rank-`panel` product, `tile_cols` columns at a time so that the pivot rows'
+// tile stays in L2. 0 picks a tile of about 128 KiB.
+//
+// The operations are those of the unblocked elimination, reordered, so
+// integer results are identical and floating point ones equal up to
+// rounding.
+template <typename T>
+void blocked_gaussian_elimination(matrix_view<T> A, size_t panel = 64,
+                                  size_t tile_cols = 0) {
+    detail::blocked_elimination(A, panel, tile_cols, nullptr);
+}
+
+namespace detail {
+// Best pivot candidate seen by one thread: larger magnitude wins, ties go to
+// the lower row, as in find_argmax_abs(). {0, row_count} loses to any row.
+template <typename T>
+struct alignas(64) pivot_candidate {
+    T abs{};
+    size_t row = 0;
+
+    bool better_than(const pivot_candidate& other) const {
+        return abs > other.abs || (abs == other.abs && row < other.row);
+    }
+};
+}  // namespace detail
+
+// blocked_gaussian_elimination() on a team of `threads` threads, 0 meaning
+// one per hardware thread. The threads run the same loop and each owns every
+// threads-th group of four rows below the current panel, so that the panel
+// updates, the trailing update and the next pivot search on a row are all
+// done by the same thread. The pivot search is a reduction over the threads'
+// candidates, which every thread then repeats on its own; the only
+// synchronization is two barriers per pivot and two per panel. Results are
+// identical to blocked_gaussian_elimination() with the same panel.
+template <typename T>
+void parallel_gaussian_elimination(matrix_view<T> A, size_t threads = 0,
+                                   size_t panel = 64, size_t tile_cols = 0) {
+    const auto row_count = A.rows();
+    const auto col_count = A.cols();
+    assert(panel > 0);
+    if (row_count == 0) {
+        return;
+    }
+    if (tile_cols == 0) {
+        tile_cols = std::max<size_t>(64, (128 << 10) / (panel * sizeof(T)));
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::clamp<size_t>(threads, 1, (row_count + 3) / 4);
+
+    // Two sets of candidates, alternating between pivots, so that a thread
+    // can post its next candidate while the others still read this one.
+    std::vector<detail::pivot_candidate<T>> candidates(2 * threads);
+    std::barrier sync(static_cast<std::ptrdiff_t>(threads));
+
+    auto run = [&](size_t tid) {
+        // Calls f(i0, i1) for each group of rows [i0, i1) owned by this
+        // thread, counting groups from `base`.
+        auto for_own_rows = [&](size_t base, size_t from, auto&& f) {
+            const size_t stride = 4 * threads;
+            size_t g = base + 4 * tid;
+            if (from > base) {
+                g += (from - base) / stride * stride;
+            }
+            for (; g < row_count; g += stride) {
+                const size_t i0 = std::max(g, from);
+                const size_t i1 = std::min(g + 4, row_count);
+                if (i0 < i1) f(i0, i1);
+            }
+        };
+
+        std::vector<size_t> pivot_cols;
+        size_t parity = 0;
+        size_t h = 0;  // row
+        size_t k = 0;  // col
+        while (h < row_count && k < col_count) {
+            const size_t h0 = h;
+            const size_t k_end = std::min(col_count, k + panel);
+            pivot_cols.clear();
+
+            for (; h < row_count && k < k_end; ++k, parity ^= 1) {
+                detail::pivot_candidate<T> best{.abs = T{}, .row = row_count};
+                for_own_rows(h0, h, [&](size_t i0, size_t i1) {
+                    for (size_t i = i0; i < i1; ++i) {
+                        using std::abs;
+                        detail::pivot_candidate<T> c{abs(A[i][k]), i};
+                        if (c.better_than(best)) best = c;
+                    }
+                });
+                auto* posted = candidates.data() + parity * threads;
+                posted[tid] = best;
+                sync.arrive_and_wait();
+
+                best = {.abs = T{}, .row = row_count};
+                for (size_t t = 0; t < threads; ++t) {
+                    if (posted[t].better_than(best)) best = posted[t];
+                }
+                if (best.abs == T{}) {
+                    continue;
+                }
+                if (tid == 0) {
+                    A.swap_rows(h, best.row);
+                }
+                sync.arrive_and_wait();
+
+                for_own_rows(h0, h + 1, [&](size_t i0, size_t i1) {
+                    for (size_t i = i0; i < i1; ++i) {
+                        auto f = A[i][k] / A[h][k];
+                        A[i][k] = f;
+                        row_update(A[i] + k + 1, A[h] + k + 1, f,
+                                   k_end - k - 1);
+                    }
+                });
+                pivot_cols.push_back(k);
+                ++h;
+            }
+            sync.arrive_and_wait();
+
+            const size_t r = pivot_cols.size();
+            const size_t trailing = col_count - k_end;
+            if (r > 0 && trailing > 0) {
+                // Forward substitution on the pivot rows, by columns.
+                auto U = A.block(h0, k_end, r, trailing);
+                const size_t per_line = std::max<size_t>(1, 64 / sizeof(T));
+                size_t chunk = (trailing + threads - 1) / threads;
+                chunk = (chunk + per_line - 1) / per_line * per_line;
+                const size_t c0 = std::min(trailing, tid * chunk);
+                const size_t c1 = std::min(trailing, c0 + chunk);
+                for (size_t t = 1; t < r && c0 < c1; ++t) {
+                    for (size_t s = 0; s < t; ++s) {
+                        row_update(U[t] + c0, U[s] + c0,
+                                   A[h0 + t][pivot_cols[s]], c1 - c0);
+                    }
+                }
+                sync.arrive_and_wait();
+
+                for (size_t j0 = 0; j0 < trailing; j0 += tile_cols) {
+                    const size_t width = std::min(tile_cols, trailing - j0);
+                    for_own_rows(h0 + r, h0 + r, [&](size_t i0, size_t i1) {
+                        detail::update_rows(A, U, pivot_cols, i0, i1, k_end,
+                                            j0, width);
+                    });
+                }
+            }
+
+            // Rows below the panel are owned from h0 + r on, as in the next
+            // panel, which therefore needs no barrier before its search.
+            for_own_rows(h0 + r, h0 + r, [&](size_t i0, size_t i1) {
+                for (size_t i = i0; i < i1; ++i) {
+                    for (auto c : pivot_cols) {
+                        A[i][c] = 0;
+                    }
+                }
+            });
+            if (tid == 0) {
+                for (size_t t = 0; t < r; ++t) {
+                    for (size_t i = h0 + t + 1; i < h0 + r; ++i) {
+                        A[i][pivot_cols[t]] = 0;
+                    }
+                }
+            }
+        }
+    };
+
+    std::vector<std::jthread> team;
+    team.reserve(threads - 1);
+    for (size_t tid = 1; tid < threads; ++tid) {
+        team.emplace_back(run, tid);
+    }
+    run(0);
+}
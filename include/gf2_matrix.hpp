@@ -0,0 +1,267 @@
+#pragma once
+
+// Matrices over GF(2), one bit per entry.
+//
+// Rows are arrays of 64-bit words in a dense_matrix, so they are 64-byte
+// aligned and padded, and adding one row to another is a word-wide XOR
+// (simd::xor_row). Elimination brings the matrix to reduced row echelon
+// form, from which rank and nullspace follow.
+//
+// gf2_method::four_russians is the Method of Four Russians (M4RI): the
+// columns are taken `kb` at a time, the up to kb pivots of the block are
+// found and reduced against each other, and the r pivots are split into four
+// groups whose 2^(r/4) sums of pivot rows are tabulated each. Every other row
+// is then cleared in the whole block with one pass over it that XORs in the
+// four table entries its pivot-column bits select (simd::xor_row4), instead
+// of up to r row XORs.
+
+#include "dense_matrix.hpp"
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class gf2_matrix {
+   public:
+    using word = std::uint64_t;
+    static constexpr size_t word_bits = 64;
+
+    gf2_matrix() = default;
+    gf2_matrix(size_t rows, size_t cols)
+        : _cols{cols}, _bits(rows, (cols + word_bits - 1) / word_bits) {}
+
+    size_t rows() const noexcept { return _bits.rows(); }
+    size_t cols() const noexcept { return _cols; }
+    size_t words() const noexcept { return _bits.cols(); }
+
+    word* row(size_t i) noexcept { return _bits[i]; }
+    const word* row(size_t i) const noexcept { return _bits[i]; }
+
+    bool get(size_t i, size_t j) const noexcept {
+        assert(j < _cols);
+        return (row(i)[j / word_bits] >> (j % word_bits)) & 1;
+    }
+    void set(size_t i, size_t j, bool value) noexcept {
+        assert(j < _cols);
+        const word bit = word{1} << (j % word_bits);
+        word& w = row(i)[j / word_bits];
+        w = value ? w | bit : w & ~bit;
+    }
+    void flip(size_t i, size_t j) noexcept {
+        assert(j < _cols);
+        row(i)[j / word_bits] ^= word{1} << (j % word_bits);
+    }
+
+    void swap_rows(size_t a, size_t b) noexcept {
+        if (a != b) {
+            std::swap_ranges(row(a), row(a) + words(), row(b));
+        }
+    }
+
+    // Row dst += row src, from word `from` on.
+    void add_row(size_t dst, size_t src, size_t from = 0) noexcept {
+        simd::xor_row(row(dst) + from, row(src) + from, words() - from);
+    }
+
+    // Number of ones in row i.
+    size_t weight(size_t i) const noexcept {
+        size_t n = 0;
+        for (size_t w = 0; w < words(); ++w) {
+            n += std::popcount(row(i)[w]);
+        }
+        return n;
+    }
+
+    // Ax for x given as the bits of one row of a matrix with cols() columns.
+    std::vector<bool> multiply(const word* x) const {
+        std::vector<bool> y(rows());
+        for (size_t i = 0; i < rows(); ++i) {
+            word parity = 0;
+            for (size_t w = 0; w < words(); ++w) {
+                parity ^= row(i)[w] & x[w];
+            }
+            y[i] = std::popcount(parity) & 1;
+        }
+        return y;
+    }
+
+   private:
+    size_t _cols = 0;
+    dense_matrix<word> _bits;
+};
+
+enum class gf2_method { plain, four_russians };
+
+struct gf2_echelon {
+    size_t rank = 0;
+    // Column of the pivot of row t, for t < rank.
+    std::vector<size_t> pivot_cols;
+};
+
+namespace detail {
+// Gauss-Jordan, one column at a time. A pivot row is zero left of its pivot
+// column, so the XORs start at the pivot's word.
+inline void gf2_plain(gf2_matrix& A, gf2_echelon& e) {
+    size_t h = 0;
+    for (size_t k = 0; h < A.rows() && k < A.cols(); ++k) {
+        size_t i_pivot = h;
+        while (i_pivot < A.rows() && !A.get(i_pivot, k)) {
+            ++i_pivot;
+        }
+        if (i_pivot == A.rows()) {
+            continue;
+        }
+        A.swap_rows(h, i_pivot);
+        const size_t w = k / gf2_matrix::word_bits;
+        const auto bit = gf2_matrix::word{1} << (k % gf2_matrix::word_bits);
+        for (size_t i = 0; i < A.rows(); ++i) {
+            if (i != h && (A.row(i)[w] & bit)) {
+                A.add_row(i, h, w);
+            }
+        }
+        e.pivot_cols.push_back(k);
+        ++h;
+    }
+    e.rank = h;
+}
+
+inline void gf2_four_russians(gf2_matrix& A, gf2_echelon& e, size_t kb) {
+    assert(kb > 0 && kb <= 64);
+    using word = gf2_matrix::word;
+    const size_t rows = A.rows();
+    std::vector<size_t> block_pivots;
+    std::vector<word> table;
+
+    size_t h = 0;
+    for (size_t c = 0; h < rows && c < A.cols(); c += kb) {
+        const size_t c_end = std::min(A.cols(), c + kb);
+        const size_t from = c / gf2_matrix::word_bits;
+        const size_t width = A.words() - from;
+
+        // Pivots of the block, each row reduced by the block's earlier
+        // pivots before it is looked at, and the pivots and the rows looked
+        // at so far reduced by each new one.
+        block_pivots.clear();
+        size_t scanned = h;  // rows [h, scanned) reduced by every pivot
+        for (size_t k = c; k < c_end && h + block_pivots.size() < rows; ++k) {
+            const size_t r = block_pivots.size();
+            size_t i_pivot = h + r;
+            for (; i_pivot < rows; ++i_pivot) {
+                if (i_pivot >= scanned) {
+                    for (size_t p = 0; p < r; ++p) {
+                        if (A.get(i_pivot, block_pivots[p])) {
+                            A.add_row(i_pivot, h + p, from);
+                        }
+                    }
+                    scanned = i_pivot + 1;
+                }
+                if (A.get(i_pivot, k)) break;
+            }
+            if (i_pivot == rows) {
+                continue;
+            }
+            A.swap_rows(h + r, i_pivot);
+            for (size_t i = h; i < scanned; ++i) {
+                if (i != h + r && A.get(i, k)) {
+                    A.add_row(i, h + r, from);
+                }
+            }
+            block_pivots.push_back(k);
+        }
+        const size_t r = block_pivots.size();
+        if (r == 0) {
+            continue;
+        }
+
+        // Group g holds pivots [first[g], first[g + 1]); in its table, entry
+        // s is the sum of the group's pivot rows selected by the bits of s.
+        size_t first[5];
+        size_t offset[4];
+        size_t total = 0;
+        for (size_t g = 0; g < 4; ++g) {
+            first[g] = g * r / 4;
+            first[g + 1] = (g + 1) * r / 4;
+            offset[g] = total;
+            total += (size_t{1} << (first[g + 1] - first[g])) * width;
+        }
+        table.assign(total, 0);
+        for (size_t g = 0; g < 4; ++g) {
+            word* t = table.data() + offset[g];
+            for (size_t s = 1; s < (size_t{1} << (first[g + 1] - first[g]));
+                 ++s) {
+                const size_t low = std::countr_zero(s);
+                word* dst = t + s * width;
+                std::copy_n(t + (s & (s - 1)) * width, width, dst);
+                simd::xor_row(dst, A.row(h + first[g] + low) + from, width);
+            }
+        }
+        for (size_t i = 0; i < rows; ++i) {
+            if (i >= h && i < h + r) continue;
+            const word* src[4];
+            bool any = false;
+            for (size_t g = 0; g < 4; ++g) {
+                size_t s = 0;
+                for (size_t p = first[g]; p < first[g + 1]; ++p) {
+                    s |= size_t{A.get(i, block_pivots[p])} << (p - first[g]);
+                }
+                src[g] = table.data() + offset[g] + s * width;
+                any |= s != 0;
+            }
+            if (any) {
+                simd::xor_row4(A.row(i) + from, src, width);
+            }
+        }
+        e.pivot_cols.insert(e.pivot_cols.end(), block_pivots.begin(),
+                            block_pivots.end());
+        h += r;
+    }
+    e.rank = h;
+}
+}  // namespace detail
+
+// Reduced row echelon form of A, in place: the first rank rows have a one in
+// their pivot column and every other row has zero there.
+inline gf2_echelon gf2_elimination(gf2_matrix& A,
+                                   gf2_method method = gf2_method::plain,
+                                   size_t kb = 32) {
+    gf2_echelon e;
+    if (method == gf2_method::four_russians) {
+        detail::gf2_four_russians(A, e, kb);
+    } else {
+        detail::gf2_plain(A, e);
+    }
+    return e;
+}
+
+inline size_t gf2_rank(gf2_matrix A, gf2_method method = gf2_method::plain) {
+    return gf2_elimination(A, method).rank;
+}
+
+// A basis of {x : Ax = 0}, one vector per row: for each column without a
+// pivot, that column set and the pivot columns set to cancel it.
+inline gf2_matrix gf2_nullspace(gf2_matrix A,
+                                gf2_method method = gf2_method::plain) {
+    const auto e = gf2_elimination(A, method);
+    std::vector<bool> is_pivot(A.cols());
+    for (auto k : e.pivot_cols) {
+        is_pivot[k] = true;
+    }
+    gf2_matrix basis(A.cols() - e.rank, A.cols());
+    size_t b = 0;
+    for (size_t f = 0; f < A.cols(); ++f) {
+        if (is_pivot[f]) continue;
+        basis.set(b, f, true);
+        for (size_t t = 0; t < e.rank; ++t) {
+            if (A.get(t, f)) {
+                basis.set(b, e.pivot_cols[t], true);
+            }
+        }
+        ++b;
+    }
+    return basis;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+// PA = LU factorization of a square matrix, kept for solving many systems
+// with the same coefficients.
+//
+// The factorization is blocked_gaussian_elimination() with the multipliers
+// left in place and the row swaps recorded, so it costs O(n^3) once. Each
+// solve is then a row permutation and two triangular substitutions, O(n^2)
+// per right-hand side. Right-hand sides are solved in blocks: B is n x k
+// with one system per column, so every substitution step is a row update
+// across all k systems and runs on the SIMD row kernels.
+
+#include "dense_matrix.hpp"
+#include "gaussian_elimination.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+template <typename T>
+class lu_factorization {
+    static_assert(std::is_floating_point_v<T>);
+
+   public:
+    lu_factorization() = default;
+
+    explicit lu_factorization(matrix_view<const T> A, size_t panel = 64)
+        : _lu(A.rows(), A.cols()) {
+        assert(A.rows() == A.cols());
+        for (size_t i = 0; i < A.rows(); ++i) {
+            std::ranges::copy(A.row(i), _lu[i]);
+        }
+        _pivots.reserve(size());
+        detail::blocked_elimination(_lu.view(), panel, 0, &_pivots);
+    }
+
+    size_t size() const noexcept { return _lu.rows(); }
+
+    // A column without a pivot leaves the factors unusable for solving;
+    // singular() is the precondition check for solving.
+    bool singular() const noexcept { return _pivots.size() < size(); }
+    size_t rank() const noexcept { return _pivots.size(); }
+
+    // L strictly below the diagonal, with an implied unit diagonal, and U on
+    // and above it. Only meaningful when !singular().
+    matrix_view<const T> factors() const noexcept { return _lu.view(); }
+
+    // Row i of PA is row permutation()[i] of A.
+    std::vector<size_t> permutation() const {
+        std::vector<size_t> perm(size());
+        std::iota(perm.begin(), perm.end(), size_t{0});
+        for (size_t h = 0; h < _pivots.size(); ++h) {
+            std::swap(perm[h], perm[_pivots[h]]);
+        }
+        return perm;
+    }
+
+    T determinant() const noexcept {
+        if (singular()) return T{};
+        T det = 1;
+        for (size_t h = 0; h < size(); ++h) {
+            det *= _pivots[h] == h ? _lu[h][h] : -_lu[h][h];
+        }
+        return det;
+    }
+
+    // Overwrites the n x k block B with the solutions X of AX = B.
+    void solve_in_place(matrix_view<T> B) const {
+        assert(!singular() && B.rows() == size());
+        for (size_t h = 0; h < _pivots.size(); ++h) {
+            B.swap_rows(h, _pivots[h]);
+        }
+        // Columns of B in tiles that keep the whole tile in L2 while every
+        // row of it is updated from all the rows before (or after) it.
+        const size_t per_line = std::max<size_t>(1, 64 / sizeof(T));
+        size_t tile = (256 << 10) / (std::max<size_t>(size(), 1) * sizeof(T));
+        tile = std::max(per_line, tile / per_line * per_line);
+        for (size_t j0 = 0; j0 < B.cols(); j0 += tile) {
+            auto X = B.block(0, j0, B.rows(), std::min(tile, B.cols() - j0));
+            forward_substitution(X);
+            back_substitution(X);
+        }
+    }
+
+    void solve_in_place(std::span<T> b) const {
+        solve_in_place(matrix_view<T>{b.data(), b.size(), 1, 1});
+    }
+
+    // The solutions of AX = B as a new matrix.
+    dense_matrix<T> solve(matrix_view<const T> B) const {
+        dense_matrix<T> X(B.rows(), B.cols());
+        for (size_t i = 0; i < B.rows(); ++i) {
+            std::ranges::copy(B.row(i), X[i]);
+        }
+        solve_in_place(X.view());
+        return X;
+    }
+
+   private:
+    // X[i] -= sum over j in [j0, j1) of LU[i][j] * X[j], four rows at a time.
+    void subtract_rows(matrix_view<T> X, size_t i, size_t j0,
+                       size_t j1) const {
+        const T* m = _lu[i];
+        size_t j = j0;
+        for (; j + 4 <= j1; j += 4) {
+            const T* src[4] = {X[j], X[j + 1], X[j + 2], X[j + 3]};
+            row_update4(X[i], src, m + j, X.cols());
+        }
+        for (; j < j1; ++j) {
+            row_update(X[i], X[j], m[j], X.cols());
+        }
+    }
+
+    // Solves LY = X in place; L has a unit diagonal.
+    void forward_substitution(matrix_view<T> X) const {
+        for (size_t i = 1; i < size(); ++i) {
+            subtract_rows(X, i, 0, i);
+        }
+    }
+
+    // Solves UX = Y in place.
+    void back_substitution(matrix_view<T> X) const {
+        for (size_t i = size(); i-- > 0;) {
+            subtract_rows(X, i, i + 1, size());
+            const T inv = T{1} / _lu[i][i];
+            for (auto& x : X.row(i)) {
+                x *= inv;
+            }
+        }
+    }
+
+    dense_matrix<T> _lu;
+    std::vector<size_t> _pivots;
+};
@@ -0,0 +1,244 @@
+#pragma once
+
+// Shortest paths from many seeds over the same graph, sharing the edge
+// scans.
+//
+// multi_source_bellman_ford() takes the seeds multi_source_paths::lanes at
+// a time and runs Bellman-Ford for all of them together: the distances are
+// a vertex x lanes matrix, one 64-byte row per vertex, and each edge (u, v)
+// is read once per pass to relax all lanes of row v against row u with a
+// vector add, compare and blend. The edge arrays thus stream through memory
+// once for every lanes seeds instead of once per seed.
+//
+// A pass expands only the vertices whose row dropped in the pass before or
+// in this one. The vectors are GCC vector extensions as wide as the
+// registers of the instruction set, under the same runtime dispatch as the
+// row kernels in simd_kernels.hpp.
+
+#include "shortest_paths.hpp"
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <vector>
+
+// Distances and predecessors from each of sources() seeds, as the engine
+// keeps them: for every batch of `lanes` seeds, a vertex x lanes matrix.
+class multi_source_paths {
+   public:
+    static constexpr size_t lanes = 64 / sizeof(distance_t);
+
+    multi_source_paths(size_t vertex_count, size_t sources)
+        : _vertex_count{vertex_count},
+          _sources{sources},
+          _distance(batches() * vertex_count * lanes,
+                    infinity<distance_t>()),
+          _predecessor(_distance.size(), null_vid) {}
+
+    size_t vertex_count() const noexcept { return _vertex_count; }
+    size_t sources() const noexcept { return _sources; }
+    size_t batches() const noexcept { return (_sources + lanes - 1) / lanes; }
+
+    // From seed s, the s-th of those given.
+    distance_t distance(size_t s, vid_t v) const noexcept {
+        return _distance[index(s, v)];
+    }
+    vid_t predecessor(size_t s, vid_t v) const noexcept {
+        return _predecessor[index(s, v)];
+    }
+
+    // The results for seed s on their own.
+    shortest_paths paths(size_t s) const {
+        shortest_paths p{distance_vector(_vertex_count),
+                         vid_vector(_vertex_count)};
+        for (size_t v = 0; v < _vertex_count; ++v) {
+            p.distance[v] = _distance[index(s, vid_t(v))];
+            p.predecessor[v] = _predecessor[index(s, vid_t(v))];
+        }
+        return p;
+    }
+
+    // Row of vertex v in batch b.
+    distance_t* distance_row(size_t b, vid_t v) noexcept {
+        return _distance.data() + (b * _vertex_count + v) * lanes;
+    }
+    vid_t* predecessor_row(size_t b, vid_t v) noexcept {
+        return _predecessor.data() + (b * _vertex_count + v) * lanes;
+    }
+
+   private:
+    size_t index(size_t s, vid_t v) const noexcept {
+        return (s / lanes * _vertex_count + v) * lanes + s % lanes;
+    }
+
+    size_t _vertex_count;
+    size_t _sources;
+    distance_vector _distance;
+    vid_vector _predecessor;
+};
+
+namespace detail {
+// Distances and predecessors of Bytes / sizeof(distance_t) lanes.
+template <size_t Bytes>
+struct distance_lanes {
+    typedef distance_t vec __attribute__((vector_size(Bytes)));
+    typedef vid_t vid_vec __attribute__((vector_size(Bytes / 2)));
+    typedef std::int32_t vid_mask __attribute__((vector_size(Bytes / 2)));
+};
+
+// Whether any lane of the comparison mask m is set, by or-ing halves.
+template <size_t Bytes>
+SIMD_INLINE bool any_lane(const typename distance_lanes<Bytes>::vec& m) {
+    if constexpr (Bytes == 16) {
+        return (m[0] | m[1]) != 0;
+    } else {
+        typename distance_lanes<Bytes / 2>::vec low, high;
+        std::memcpy(&low, &m, sizeof low);
+        std::memcpy(&high, reinterpret_cast<const char*>(&m) + sizeof low,
+                    sizeof high);
+        return any_lane<Bytes / 2>(low | high);
+    }
+}
+
+// One pass over batch b: each vertex whose row dropped since pass - 1 has
+// its out-edges relaxed for all lanes, Bytes of them per vector. Rows are
+// only written where a lane drops. Returns whether any did; those rows get
+// the stamp `pass`. Always inlined, so that it is compiled for the
+// instruction set of the function it is called from.
+template <size_t Bytes, typename Graph, typename WeightFunc>
+SIMD_INLINE bool multi_source_pass(const Graph& g, WeightFunc& w,
+                                   multi_source_paths& paths, size_t b,
+                                   std::vector<size_t>& dropped,
+                                   size_t pass) {
+    constexpr size_t L = multi_source_paths::lanes;
+    constexpr size_t per_vec = Bytes / sizeof(distance_t);
+    constexpr size_t vecs = L / per_vec;
+    using vec = typename distance_lanes<Bytes>::vec;
+    using vid_vec = typename distance_lanes<Bytes>::vid_vec;
+
+    distance_t* const D = paths.distance_row(b, 0);
+    vid_t* const P = paths.predecessor_row(b, 0);
+    size_t* const stamp = dropped.data();
+    bool modified = false;
+    for (auto u : vertices(g)) {
+        if (stamp[u] + 1 < pass) {
+            continue;
+        }
+        // The weight is masked out of the unreachable lanes, which stay at
+        // infinity and so never win the minimum.
+        vec d_u[vecs];
+        vec reachable[vecs];
+        for (size_t h = 0; h < vecs; ++h) {
+            std::memcpy(&d_u[h], D + size_t(u) * L + h * per_vec, Bytes);
+            reachable[h] = d_u[h] != infinity<distance_t>();
+        }
+
+        for (const auto& e : out_edges(g, u)) {
+            const vid_t v = target(e);
+            const distance_t w_e = w(e);
+            distance_t* const row = D + size_t(v) * L;
+            vec d_v[vecs];
+            vec candidate[vecs];
+            vec improved[vecs];
+            vec improved_any{};
+            for (size_t h = 0; h < vecs; ++h) {
+                std::memcpy(&d_v[h], row + h * per_vec, Bytes);
+                candidate[h] = d_u[h] + (reachable[h] & w_e);
+                improved[h] = candidate[h] < d_v[h];
+                improved_any |= improved[h];
+            }
+            if (!any_lane<Bytes>(improved_any)) {
+                continue;
+            }
+
+            vid_t* const p_row = P + size_t(v) * L;
+            for (size_t h = 0; h < vecs; ++h) {
+                d_v[h] = improved[h] ? candidate[h] : d_v[h];
+                std::memcpy(row + h * per_vec, &d_v[h], Bytes);
+                const auto take = __builtin_convertvector(
+                    improved[h], typename distance_lanes<Bytes>::vid_mask);
+                vid_vec p;
+                std::memcpy(&p, p_row + h * per_vec, Bytes / 2);
+                p = take ? vid_vec{} + u : p;
+                std::memcpy(p_row + h * per_vec, &p, Bytes / 2);
+            }
+            stamp[v] = pass;
+            modified = true;
+        }
+    }
+    return modified;
+}
+
+template <typename Graph, typename WeightFunc>
+bool multi_source_pass_portable(const Graph& g, WeightFunc& w,
+                                multi_source_paths& paths, size_t b,
+                                std::vector<size_t>& dropped, size_t pass) {
+    return multi_source_pass<16>(g, w, paths, b, dropped, pass);
+}
+
+#ifdef SIMD_KERNELS_X86
+template <typename Graph, typename WeightFunc>
+SIMD_AVX2 bool multi_source_pass_avx2(const Graph& g, WeightFunc& w,
+                                      multi_source_paths& paths, size_t b,
+                                      std::vector<size_t>& dropped,
+                                      size_t pass) {
+    return multi_source_pass<32>(g, w, paths, b, dropped, pass);
+}
+
+template <typename Graph, typename WeightFunc>
+SIMD_AVX512 bool multi_source_pass_avx512(const Graph& g, WeightFunc& w,
+                                          multi_source_paths& paths,
+                                          size_t b,
+                                          std::vector<size_t>& dropped,
+                                          size_t pass) {
+    return multi_source_pass<64>(g, w, paths, b, dropped, pass);
+}
+#endif
+}  // namespace detail
+
+// bellman_ford() from every seed, multi_source_paths::lanes seeds per sweep
+// over the edges. At most |V| - 1 passes per batch, so with a negative cycle
+// reachable from a seed the results are as meaningless as bellman_ford()'s.
+template <typename Graph, typename WeightFunc>
+multi_source_paths multi_source_bellman_ford(const Graph& g, WeightFunc w,
+                                             std::span<const vid_t> seeds) {
+    constexpr size_t L = multi_source_paths::lanes;
+    const size_t n = std::size(vertices(g));
+    multi_source_paths paths(n, seeds.size());
+    // Pass in which each vertex's row last dropped; the seeds' in pass 1.
+    std::vector<size_t> dropped(n);
+
+    auto pass = [&](size_t b, size_t p) {
+#ifdef SIMD_KERNELS_X86
+        switch (simd::active_isa()) {
+            case simd::isa::avx512:
+                return detail::multi_source_pass_avx512(g, w, paths, b,
+                                                        dropped, p);
+            case simd::isa::avx2:
+                return detail::multi_source_pass_avx2(g, w, paths, b,
+                                                      dropped, p);
+            case simd::isa::portable:
+                break;
+        }
+#endif
+        return detail::multi_source_pass_portable(g, w, paths, b, dropped, p);
+    };
+
+    for (size_t b = 0; b < paths.batches(); ++b) {
+        std::ranges::fill(dropped, 0);
+        for (size_t k = 0; k < L && b * L + k < seeds.size(); ++k) {
+            const vid_t seed = seeds[b * L + k];
+            assert(seed < n);
+            paths.distance_row(b, seed)[k] = 0;
+            dropped[seed] = 1;
+        }
+        for (size_t p = 2; p <= n && pass(b, p); ++p) {
+        }
+    }
+    return paths;
+}
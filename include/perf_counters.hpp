@@ -0,0 +1,186 @@
+#pragma once
+
+// Hardware performance counters for the calling thread via perf_event_open.
+//
+// Cycles, instructions, LLC misses and branch misses are opened as one group,
+// so they are always scheduled (and multiplexed) together and their ratios
+// stay consistent. Counters that cannot be opened -- no PMU in a VM,
+// perf_event_paranoid, seccomp in containers, non-Linux targets -- are simply
+// missing from the readings; nothing here ever fails hard.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+namespace mk::perf {
+
+enum class event : std::size_t {
+    cycles,
+    instructions,
+    llc_misses,
+    branch_misses,
+};
+inline constexpr std::size_t event_count = 4;
+
+struct reading {
+    std::array<std::uint64_t, event_count> values{};
+    std::uint32_t valid = 0;  // Bit i is set if event i was counted.
+
+    bool has(event e) const noexcept {
+        return valid & (1u << static_cast<std::size_t>(e));
+    }
+
+    std::optional<std::uint64_t> get(event e) const noexcept {
+        if (!has(e)) return std::nullopt;
+        return values[static_cast<std::size_t>(e)];
+    }
+
+    // Instructions per cycle.
+    std::optional<double> ipc() const noexcept {
+        auto c = get(event::cycles);
+        auto i = get(event::instructions);
+        if (!c || !i || *c == 0) return std::nullopt;
+        return static_cast<double>(*i) / *c;
+    }
+
+    std::optional<double> per_element(event e,
+                                      std::size_t elements) const noexcept {
+        auto v = get(e);
+        if (!v || elements == 0) return std::nullopt;
+        return static_cast<double>(*v) / elements;
+    }
+
+    friend reading operator-(const reading& a, const reading& b) noexcept {
+        reading r;
+        r.valid = a.valid & b.valid;
+        for (std::size_t i = 0; i < event_count; ++i) {
+            r.values[i] = a.values[i] - b.values[i];
+        }
+        return r;
+    }
+};
+
+class counter_group {
+   public:
+    counter_group() {
+#ifdef __linux__
+        constexpr std::array<std::pair<std::uint32_t, std::uint64_t>,
+                             event_count>
+            configs = {{
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            }};
+
+        for (std::size_t i = 0; i < event_count; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = configs[i].first;
+            attr.config = configs[i].second;
+            attr.disabled = _leader < 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP |
+                               PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            int fd = static_cast<int>(
+                syscall(SYS_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1,
+                        /*group_fd=*/_leader, /*flags=*/0));
+            if (fd < 0) {
+                if (_error.empty()) {
+                    _error = std::strerror(errno);
+                }
+                continue;
+            }
+            if (_leader < 0) {
+                _leader = fd;
+            }
+            _fds[_opened] = fd;
+            _slots[_opened] = i;
+            ++_opened;
+        }
+
+        if (_leader >= 0) {
+            ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#else
+        _error = "perf_event_open is Linux only";
+#endif
+    }
+
+    ~counter_group() {
+#ifdef __linux__
+        for (std::size_t i = 0; i < _opened; ++i) {
+            close(_fds[i]);
+        }
+#endif
+    }
+
+    counter_group(const counter_group&) = delete;
+    counter_group& operator=(const counter_group&) = delete;
+
+    bool available() const noexcept { return _opened > 0; }
+
+    // Reason why (some) counters could not be opened, empty if all were.
+    const std::string& error() const noexcept { return _error; }
+
+    // Current counter values, scaled up if the group was multiplexed.
+    reading read() const noexcept {
+        reading r;
+#ifdef __linux__
+        if (_leader < 0) return r;
+
+        struct {
+            std::uint64_t nr;
+            std::uint64_t time_enabled;
+            std::uint64_t time_running;
+            std::uint64_t values[event_count];
+        } buf;
+        if (::read(_leader, &buf, sizeof(buf)) < 0 ||
+            buf.time_running == 0) {
+            return r;
+        }
+
+        double scale = static_cast<double>(buf.time_enabled) /
+                       static_cast<double>(buf.time_running);
+        for (std::size_t i = 0; i < buf.nr && i < _opened; ++i) {
+            r.values[_slots[i]] =
+                static_cast<std::uint64_t>(buf.values[i] * scale);
+            r.valid |= 1u << _slots[i];
+        }
+#endif
+        return r;
+    }
+
+   private:
+    int _leader = -1;
+    std::size_t _opened = 0;
+    std::array<int, event_count> _fds{};
+    std::array<std::size_t, event_count> _slots{};
+    std::string _error;
+};
+
+// Counters are per thread, so each thread opens its own group on first use.
+inline counter_group& thread_counters() {
+    thread_local counter_group group;
+    return group;
+}
+
+}  // namespace mk::perf
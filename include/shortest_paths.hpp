@@ -0,0 +1,545 @@
+#pragma once
+
+// Single-source shortest paths on graphs with the csr_graph interface:
+// vertices(g), edges(g), out_edges(g, u), source(e) and target(e), with the
+// weight of an edge given by a function w(e).
+//
+// bellman_ford() relaxes every edge in each pass, in storage order.
+//
+// spfa() queues the vertices whose distance dropped and relaxes only their
+// out-edges, and detects negative cycles reachable from the seed.
+//
+// parallel_bellman_ford() relaxes, in each round, only the out-edges of the
+// vertices whose distance dropped in the round before (the frontier), on a
+// team of threads. Distances are lowered with an atomic compare-and-swap
+// minimum, so a round may already see the improvements of the same round.
+//
+// delta_stepping() needs non-negative weights. It keeps the vertices in
+// buckets of distance width delta and settles them a bucket at a time: the
+// light edges (weight <= delta) of a bucket are relaxed in parallel until
+// the bucket stays empty, then its heavy edges once. delta trades the work
+// of Dijkstra's algorithm (small delta) against the parallelism of
+// Bellman-Ford (large delta).
+//
+// The parallel engines set predecessor[v] to the u whose relaxation gave v
+// its final distance, as the sequential one does. A thread records each
+// relaxation that won the minimum and, after the round, keeps the one that
+// still matches d[v]; distances only ever drop, so at most one does.
+
+#include "csr_graph.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Signed, as Bellman-Ford allows negative weights.
+using distance_t = std::int64_t;
+using distance_vector = std::vector<distance_t>;
+
+template <typename T>
+constexpr T infinity() {
+    return std::numeric_limits<T>::max();
+}
+
+using vid_t = graph_detail::vertex_id;
+static constexpr vid_t null_vid = infinity<vid_t>();
+using vid_vector = std::vector<vid_t>;
+
+struct shortest_paths {
+    distance_vector distance;  // infinity<distance_t>() if unreachable
+    vid_vector predecessor;    // null_vid for the seed and unreachable
+};
+
+template <typename Graph, typename WeightFunc>
+shortest_paths bellman_ford(const Graph& g, WeightFunc w, vid_t seed) {
+    const auto& V = vertices(g);
+
+    // init
+    distance_vector d(std::size(V), infinity<distance_t>());
+    vid_vector predecessor(std::size(V), null_vid);
+
+    d[seed] = 0;
+    // dla i od 1 do |V[G]| - 1 wykonaj
+    for (size_t i = 1; i < std::size(V); ++i) {
+        //   dla każdej krawędzi (u,v) w E[G] wykonaj
+        bool modified = false;
+        for (const auto& e : edges(g)) {
+            const distance_t d_u = d[source(e)];
+            if (d_u == infinity<distance_t>()) {
+                continue;
+            }
+            //     jeżeli d[v] > d[u] + w(u,v) to
+            auto new_weight = d_u + w(e);
+            if (new_weight < d[target(e)]) {
+                //       d[v] = d[u] + w(u,v)
+                d[target(e)] = new_weight;
+                //       poprzednik[v] = u
+                predecessor[target(e)] = source(e);
+
+                modified = true;
+            }
+        }
+        if (!modified) {
+            // Optimization: don't repeat if no edge was relaxed in this
+            // iteration.
+            break;
+        }
+    }
+    return {std::move(d), std::move(predecessor)};
+}
+
+// spfa()'s result. If a negative cycle is reachable from the seed, the
+// search stops at it and negative_cycle holds its vertices in path order,
+// each with an edge to the next and the last to the first; the distances
+// are then not final.
+struct spfa_result {
+    shortest_paths paths;
+    vid_vector negative_cycle;
+};
+
+namespace detail {
+// The cycle the predecessors of v lead into, in path order, or nothing if
+// they lead back to the seed.
+inline vid_vector predecessor_cycle(const vid_vector& predecessor, vid_t v) {
+    // After |V| steps the walk is on the cycle if there is one.
+    for (size_t i = 0; i < predecessor.size(); ++i) {
+        v = predecessor[v];
+        if (v == null_vid) {
+            return {};
+        }
+    }
+    vid_vector cycle;
+    vid_t u = v;
+    do {
+        cycle.push_back(u);
+        u = predecessor[u];
+    } while (u != v);
+    std::ranges::reverse(cycle);
+    return cycle;
+}
+}  // namespace detail
+
+// Bellman-Ford with a queue (SPFA): a vertex is queued when its distance
+// drops, and only the out-edges of queued vertices are relaxed. The queue
+// order follows two heuristics: Small Label First queues a vertex whose
+// distance is below the front's at the front rather than the back, and
+// Large Label Last moves the front to the back while its distance is above
+// the queue's average.
+//
+// hops[v] counts the edges of v's current path, one more than its
+// predecessor's on every relaxation. A path of |V| edges repeats a vertex,
+// so the predecessors are then searched for a cycle, which can only be
+// negative. The search is repeated every |V| hops after a miss, as a
+// predecessor chain can have become shorter than the hops count says.
+template <typename Graph, typename WeightFunc>
+spfa_result spfa(const Graph& g, WeightFunc w, vid_t seed) {
+    const size_t n = std::size(vertices(g));
+    distance_vector d(n, infinity<distance_t>());
+    vid_vector predecessor(n, null_vid);
+    std::vector<size_t> hops(n, 0);
+    std::vector<bool> queued(n, false);
+    std::deque<vid_t> queue;
+    double queued_sum = 0;  // of the queued distances, for the average
+    size_t next_search = n;
+
+    d[seed] = 0;
+    queue.push_back(seed);
+    queued[seed] = true;
+    while (!queue.empty()) {
+        const double average = queued_sum / double(queue.size());
+        for (size_t i = 1; i < queue.size() && d[queue.front()] > average;
+             ++i) {
+            queue.push_back(queue.front());
+            queue.pop_front();
+        }
+        const vid_t u = queue.front();
+        queue.pop_front();
+        queued[u] = false;
+        queued_sum -= double(d[u]);
+
+        const distance_t d_u = d[u];
+        for (const auto& e : out_edges(g, u)) {
+            const vid_t v = target(e);
+            const distance_t d_v = d_u + w(e);
+            if (d_v >= d[v]) {
+                continue;
+            }
+            if (queued[v]) {
+                queued_sum -= double(d[v]);
+            }
+            d[v] = d_v;
+            predecessor[v] = u;
+            hops[v] = hops[u] + 1;
+            if (hops[v] >= next_search) {
+                auto cycle = detail::predecessor_cycle(predecessor, v);
+                if (!cycle.empty()) {
+                    return {{std::move(d), std::move(predecessor)},
+                            std::move(cycle)};
+                }
+                next_search = hops[v] + n;
+            }
+            queued_sum += double(d_v);
+            if (!queued[v]) {
+                queued[v] = true;
+                if (!queue.empty() && d_v < d[queue.front()]) {
+                    queue.push_front(v);
+                } else {
+                    queue.push_back(v);
+                }
+            }
+        }
+    }
+    return {{std::move(d), std::move(predecessor)}, {}};
+}
+
+namespace detail {
+inline distance_t load_distance(distance_t& d) noexcept {
+    return std::atomic_ref(d).load(std::memory_order_relaxed);
+}
+
+// Lowers d to value if that is smaller; true if this call did.
+inline bool atomic_min(distance_t& d, distance_t value) noexcept {
+    std::atomic_ref a(d);
+    distance_t current = a.load(std::memory_order_relaxed);
+    while (value < current) {
+        if (a.compare_exchange_weak(current, value,
+                                    std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sets stamp to value; true if it was not value already.
+inline bool exchange_stamp(size_t& stamp, size_t value) noexcept {
+    std::atomic_ref a(stamp);
+    return a.load(std::memory_order_relaxed) != value &&
+           a.exchange(value, std::memory_order_relaxed) != value;
+}
+
+// v reached at distance d through u, by a successful atomic_min.
+struct relaxation {
+    vid_t v;
+    vid_t u;
+    distance_t d;
+};
+
+inline void set_predecessors(std::vector<relaxation>& relaxed,
+                             const distance_vector& d,
+                             vid_vector& predecessor) {
+    for (const auto& r : relaxed) {
+        if (d[r.v] == r.d) {
+            predecessor[r.v] = r.u;
+        }
+    }
+    relaxed.clear();
+}
+
+// Vertices in one list per thread, handed out to the whole team in chunks
+// through a shared cursor. publish() is called by one thread, between
+// barriers, after the lists are filled.
+class shared_worklist {
+   public:
+    explicit shared_worklist(size_t threads)
+        : lists(threads), _starts(threads + 1, 0) {}
+
+    std::vector<std::vector<vid_t>> lists;
+
+    void publish() noexcept {
+        for (size_t t = 0; t < lists.size(); ++t) {
+            _starts[t + 1] = _starts[t] + lists[t].size();
+        }
+        _cursor.store(0, std::memory_order_relaxed);
+    }
+
+    size_t size() const noexcept { return _starts.back(); }
+
+    template <typename F>
+    void claim(F&& f) {
+        constexpr size_t chunk = 256;
+        for (;;) {
+            size_t i = _cursor.fetch_add(chunk, std::memory_order_relaxed);
+            if (i >= size()) {
+                return;
+            }
+            const size_t end = std::min(size(), i + chunk);
+            size_t t = std::upper_bound(_starts.begin(), _starts.end(), i) -
+                       _starts.begin() - 1;
+            for (; i < end; ++t) {
+                const size_t stop = std::min(end, _starts[t + 1]);
+                for (; i < stop; ++i) {
+                    f(lists[t][i - _starts[t]]);
+                }
+            }
+        }
+    }
+
+    // Hands out [0, count) instead, with the same cursor.
+    template <typename F>
+    void claim_range(size_t count, F&& f) {
+        constexpr size_t chunk = 1024;
+        for (;;) {
+            size_t i = _cursor.fetch_add(chunk, std::memory_order_relaxed);
+            if (i >= count) {
+                return;
+            }
+            const size_t end = std::min(count, i + chunk);
+            for (; i < end; ++i) {
+                f(i);
+            }
+        }
+    }
+
+   private:
+    std::vector<size_t> _starts;
+    alignas(64) std::atomic<size_t> _cursor{0};
+};
+
+inline size_t team_size(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return threads;
+}
+
+template <typename F>
+void run_team(size_t threads, F&& run) {
+    std::vector<std::jthread> team;
+    team.reserve(threads - 1);
+    for (size_t tid = 1; tid < threads; ++tid) {
+        team.emplace_back(run, tid);
+    }
+    run(0);
+}
+}  // namespace detail
+
+// bellman_ford() on a team of `threads` threads, 0 meaning one per hardware
+// thread, relaxing only the frontier's out-edges in each round. A frontier
+// of more than |V| / 16 vertices is expanded in vertex order, by a scan over
+// the frontier marks, so that the edge arrays are read front to back as in
+// bellman_ford() rather than at random. At most |V| - 1 rounds, so with a
+// negative cycle reachable from the seed the result is as meaningless as
+// bellman_ford()'s.
+template <typename Graph, typename WeightFunc>
+shortest_paths parallel_bellman_ford(const Graph& g, WeightFunc w, vid_t seed,
+                                     size_t threads = 0) {
+    const size_t n = std::size(vertices(g));
+    threads = detail::team_size(threads);
+
+    distance_vector d(n, infinity<distance_t>());
+    vid_vector predecessor(n, null_vid);
+    std::vector<size_t> queued(n, 0);  // last round v is in the frontier of
+    d[seed] = 0;
+    queued[seed] = 1;
+
+    detail::shared_worklist frontier(threads);
+    std::vector<std::vector<vid_t>> next(threads);
+    std::vector<std::vector<detail::relaxation>> relaxed(threads);
+    frontier.lists[0].push_back(seed);
+    frontier.publish();
+    bool dense = false;
+    std::barrier sync(static_cast<std::ptrdiff_t>(threads));
+
+    detail::run_team(threads, [&](size_t tid) {
+        for (size_t round = 1; round < n && frontier.size() > 0; ++round) {
+            auto expand = [&](vid_t u) {
+                const distance_t d_u = detail::load_distance(d[u]);
+                for (const auto& e : out_edges(g, u)) {
+                    const vid_t v = target(e);
+                    const distance_t d_v = d_u + w(e);
+                    if (detail::atomic_min(d[v], d_v)) {
+                        relaxed[tid].push_back({v, u, d_v});
+                        if (detail::exchange_stamp(queued[v], round + 1)) {
+                            next[tid].push_back(v);
+                        }
+                    }
+                }
+            };
+            if (dense) {
+                // Also expands the vertices that already joined the next
+                // frontier, which is redundant but harmless.
+                frontier.claim_range(n, [&](size_t u) {
+                    if (std::atomic_ref(queued[u]).load(
+                            std::memory_order_relaxed) >= round) {
+                        expand(vid_t(u));
+                    }
+                });
+            } else {
+                frontier.claim(expand);
+            }
+            sync.arrive_and_wait();
+
+            detail::set_predecessors(relaxed[tid], d, predecessor);
+            if (tid == 0) {
+                for (size_t t = 0; t < threads; ++t) {
+                    std::swap(frontier.lists[t], next[t]);
+                    next[t].clear();
+                }
+                frontier.publish();
+                dense = frontier.size() > n / 16;
+            }
+            sync.arrive_and_wait();
+        }
+    });
+    return {std::move(d), std::move(predecessor)};
+}
+
+// Shortest paths for non-negative weights by delta-stepping on a team of
+// `threads` threads, 0 meaning one per hardware thread. While bucket i is
+// settled, every pending distance is below (i + 1) delta + the largest
+// weight, so max_weight / delta + 2 buckets, reused cyclically, hold them
+// all. The ring is capped at 4096 buckets; buckets beyond it, which only
+// weights over 4094 delta reach, wait in a sparse map per thread.
+template <typename Graph, typename WeightFunc>
+shortest_paths delta_stepping(const Graph& g, WeightFunc w, vid_t seed,
+                              distance_t delta, size_t threads = 0) {
+    assert(delta > 0);
+    const size_t n = std::size(vertices(g));
+    threads = detail::team_size(threads);
+
+    distance_vector d(n, infinity<distance_t>());
+    vid_vector predecessor(n, null_vid);
+    std::vector<size_t> expanded(n, 0);  // last phase v's edges were relaxed
+    std::vector<size_t> settled(n, 0);   // 1 + last bucket v was settled in
+    d[seed] = 0;
+
+    distance_t max_weight = 0;
+    for (const auto& e : edges(g)) {
+        max_weight = std::max<distance_t>(max_weight, w(e));
+    }
+    constexpr size_t max_ring = 4096;
+    const size_t ring = static_cast<size_t>(
+        std::min<distance_t>(max_weight / delta + 2, max_ring));
+
+    // buckets[t][b % ring]: vertices thread t lowered into
+    // [b delta, (b + 1) delta), for b < bucket + ring; far[t][b] for the
+    // rest. Entries go stale when the vertex drops to a lower bucket later.
+    std::vector<std::vector<std::vector<vid_t>>> buckets(
+        threads, std::vector<std::vector<vid_t>>(ring));
+    std::vector<std::map<size_t, std::vector<vid_t>>> far(threads);
+    buckets[0][0].push_back(seed);
+
+    detail::shared_worklist current(threads);
+    std::vector<std::vector<vid_t>> heavy(threads);
+    std::vector<std::vector<detail::relaxation>> relaxed(threads);
+    size_t bucket = 0;
+    size_t phase = 0;
+    bool done = false;
+    std::barrier sync(static_cast<std::ptrdiff_t>(threads));
+
+    // Moves bucket b of every thread to the worklist, as a new phase.
+    auto take_bucket = [&] {
+        for (size_t t = 0; t < threads; ++t) {
+            auto& list = current.lists[t];
+            list.clear();
+            std::swap(list, buckets[t][bucket % ring]);
+            if (!far[t].empty() && far[t].begin()->first == bucket) {
+                const auto& f = far[t].begin()->second;
+                list.insert(list.end(), f.begin(), f.end());
+                far[t].erase(far[t].begin());
+            }
+        }
+        current.publish();
+        ++phase;
+    };
+    // Advances bucket to the next non-empty one; false if there is none.
+    auto next_bucket = [&] {
+        size_t nearest_far = std::numeric_limits<size_t>::max();
+        for (const auto& f : far) {
+            if (!f.empty()) {
+                nearest_far = std::min(nearest_far, f.begin()->first);
+            }
+        }
+        for (size_t k = 0; k < ring && bucket < nearest_far; ++k, ++bucket) {
+            for (size_t t = 0; t < threads; ++t) {
+                if (!buckets[t][bucket % ring].empty()) return true;
+            }
+        }
+        if (nearest_far == std::numeric_limits<size_t>::max()) {
+            return false;
+        }
+        // The ring is empty up to the nearest far bucket.
+        bucket = nearest_far;
+        return true;
+    };
+
+    detail::run_team(threads, [&](size_t tid) {
+        auto relax = [&](vid_t u, distance_t d_u, const auto& e) {
+            assert(w(e) >= 0);
+            const vid_t v = target(e);
+            const distance_t d_v = d_u + w(e);
+            if (detail::atomic_min(d[v], d_v)) {
+                relaxed[tid].push_back({v, u, d_v});
+                const size_t b = static_cast<size_t>(d_v / delta);
+                if (b < bucket + ring) {
+                    buckets[tid][b % ring].push_back(v);
+                } else {
+                    far[tid][b].push_back(v);
+                }
+            }
+        };
+
+        for (;;) {
+            if (tid == 0) {
+                done = !next_bucket();
+                if (!done) {
+                    take_bucket();
+                }
+            }
+            sync.arrive_and_wait();
+            if (done) {
+                break;
+            }
+
+            // Light edges, until no vertex drops into this bucket again.
+            while (current.size() > 0) {
+                current.claim([&](vid_t u) {
+                    const distance_t d_u = detail::load_distance(d[u]);
+                    if (static_cast<size_t>(d_u / delta) != bucket ||
+                        !detail::exchange_stamp(expanded[u], phase)) {
+                        return;
+                    }
+                    if (detail::exchange_stamp(settled[u], bucket + 1)) {
+                        heavy[tid].push_back(u);
+                    }
+                    for (const auto& e : out_edges(g, u)) {
+                        if (w(e) <= delta) {
+                            relax(u, d_u, e);
+                        }
+                    }
+                });
+                sync.arrive_and_wait();
+
+                detail::set_predecessors(relaxed[tid], d, predecessor);
+                if (tid == 0) {
+                    take_bucket();
+                }
+                sync.arrive_and_wait();
+            }
+
+            // Heavy edges, once, from the bucket's final distances.
+            for (auto u : heavy[tid]) {
+                const distance_t d_u = detail::load_distance(d[u]);
+                for (const auto& e : out_edges(g, u)) {
+                    if (w(e) > delta) {
+                        relax(u, d_u, e);
+                    }
+                }
+            }
+            heavy[tid].clear();
+            sync.arrive_and_wait();
+            detail::set_predecessors(relaxed[tid], d, predecessor);
+        }
+    });
+    return {std::move(d), std::move(predecessor)};
+}
@@ -0,0 +1,563 @@
+#pragma once
+
+// Row update kernels for elimination, dst[j] -= f * src[j], for float,
+// double and int32, with AVX2 and AVX-512 implementations picked at runtime
+// and a portable fallback.
+//
+// The CPU is queried once (cpuid through __builtin_cpu_supports, which also
+// checks that the OS saves the wide registers); select_isa() can lower the
+// choice, e.g. to compare the paths. The x86 paths are compiled with target
+// attributes, so the rest of the program needs no -m flags. They fuse the
+// multiply and subtract for float and double, which rounds once instead of
+// twice; int32 results are the same on every path.
+//
+// The XOR kernels, dst ^= src over 64-bit words, are the row update of
+// elimination over GF(2).
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define SIMD_KERNELS_X86 1
+#define SIMD_AVX2 __attribute__((target("avx2,fma")))
+#define SIMD_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#define SIMD_INLINE inline __attribute__((always_inline))
+#else
+#define SIMD_INLINE inline
+#endif
+
+namespace simd {
+
+enum class isa { portable, avx2, avx512 };
+
+inline std::string_view to_string(isa i) {
+    switch (i) {
+        case isa::portable:
+            return "portable";
+        case isa::avx2:
+            return "avx2";
+        case isa::avx512:
+            return "avx512";
+    }
+    return "?";
+}
+
+// Best instruction set this CPU supports.
+inline isa detected_isa() noexcept {
+    static const isa detected = [] {
+#ifdef SIMD_KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return isa::avx512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return isa::avx2;
+        }
+#endif
+        return isa::portable;
+    }();
+    return detected;
+}
+
+namespace detail {
+inline isa& selected() noexcept {
+    static isa selected = detected_isa();
+    return selected;
+}
+}  // namespace detail
+
+// Instruction set the kernels currently use.
+inline isa active_isa() noexcept { return detail::selected(); }
+
+// Uses `i` if the CPU supports it, otherwise the best supported one below
+// it. Returns the instruction set now in use. Not thread-safe.
+inline isa select_isa(isa i) noexcept {
+    detail::selected() = i < detected_isa() ? i : detected_isa();
+    return active_isa();
+}
+
+template <typename T>
+inline constexpr bool has_row_kernels =
+    std::is_same_v<T, float> || std::is_same_v<T, double> ||
+    std::is_same_v<T, std::int32_t>;
+
+template <typename T>
+void row_update_portable(T* dst, const T* src, T f, size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        dst[j] -= src[j] * f;
+    }
+}
+
+template <typename T>
+void row_update4_portable(T* dst, const T* const* src, const T* f,
+                          size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        dst[j] = dst[j] - src[0][j] * f[0] - src[1][j] * f[1] -
+                 src[2][j] * f[2] - src[3][j] * f[3];
+    }
+}
+
+template <typename T>
+void row_update4x4_portable(T* const* dst, const T* const* src,
+                            const T (*f)[4], size_t n) {
+    for (size_t r = 0; r < 4; ++r) {
+        row_update4_portable(dst[r], src, f[r], n);
+    }
+}
+
+inline void xor_row_portable(std::uint64_t* dst, const std::uint64_t* src,
+                             size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        dst[j] ^= src[j];
+    }
+}
+
+inline void xor_row4_portable(std::uint64_t* dst,
+                              const std::uint64_t* const* src, size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        dst[j] ^= src[0][j] ^ src[1][j] ^ src[2][j] ^ src[3][j];
+    }
+}
+
+#ifdef SIMD_KERNELS_X86
+
+// Per type and instruction set: the vector type, its width, unaligned
+// load/store, broadcast and nmadd(a, b, c) = c - a * b.
+template <typename T>
+struct avx2_ops;
+
+template <>
+struct avx2_ops<double> {
+    using vec = __m256d;
+    static constexpr size_t width = 4;
+    SIMD_AVX2 SIMD_INLINE static vec load(const double* p) {
+        return _mm256_loadu_pd(p);
+    }
+    SIMD_AVX2 SIMD_INLINE static void store(double* p, vec v) {
+        _mm256_storeu_pd(p, v);
+    }
+    SIMD_AVX2 SIMD_INLINE static vec set1(double x) {
+        return _mm256_set1_pd(x);
+    }
+    SIMD_AVX2 SIMD_INLINE static vec nmadd(vec a, vec b, vec c) {
+        return _mm256_fnmadd_pd(a, b, c);
+    }
+};
+
+template <>
+struct avx2_ops<float> {
+    using vec = __m256;
+    static constexpr size_t width = 8;
+    SIMD_AVX2 SIMD_INLINE static vec load(const float* p) {
+        return _mm256_loadu_ps(p);
+    }
+    SIMD_AVX2 SIMD_INLINE static void store(float* p, vec v) {
+        _mm256_storeu_ps(p, v);
+    }
+    SIMD_AVX2 SIMD_INLINE static vec set1(float x) {
+        return _mm256_set1_ps(x);
+    }
+    SIMD_AVX2 SIMD_INLINE static vec nmadd(vec a, vec b, vec c) {
+        return _mm256_fnmadd_ps(a, b, c);
+    }
+};
+
+template <>
+struct avx2_ops<std::int32_t> {
+    using vec = __m256i;
+    static constexpr size_t width = 8;
+    SIMD_AVX2 SIMD_INLINE static vec load(const std::int32_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+    SIMD_AVX2 SIMD_INLINE static void store(std::int32_t* p, vec v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+    }
+    SIMD_AVX2 SIMD_INLINE static vec set1(std::int32_t x) {
+        return _mm256_set1_epi32(x);
+    }
+    SIMD_AVX2 SIMD_INLINE static vec nmadd(vec a, vec b, vec c) {
+        return _mm256_sub_epi32(c, _mm256_mullo_epi32(a, b));
+    }
+};
+
+// The AVX-512 ones also load and store the tail under a mask.
+template <typename T>
+struct avx512_ops;
+
+template <>
+struct avx512_ops<double> {
+    using vec = __m512d;
+    using mask = __mmask8;
+    static constexpr size_t width = 8;
+    SIMD_AVX512 SIMD_INLINE static vec load(const double* p) {
+        return _mm512_loadu_pd(p);
+    }
+    SIMD_AVX512 SIMD_INLINE static void store(double* p, vec v) {
+        _mm512_storeu_pd(p, v);
+    }
+    SIMD_AVX512 SIMD_INLINE static vec load(const double* p, mask m) {
+        return _mm512_maskz_loadu_pd(m, p);
+    }
+    SIMD_AVX512 SIMD_INLINE static void store(double* p, vec v, mask m) {
+        _mm512_mask_storeu_pd(p, m, v);
+    }
+    SIMD_AVX512 SIMD_INLINE static vec set1(double x) {
+        return _mm512_set1_pd(x);
+    }
+    SIMD_AVX512 SIMD_INLINE static vec nmadd(vec a, vec b, vec c) {
+        return _mm512_fnmadd_pd(a, b, c);
+    }
+};
+
+template <>
+struct avx512_ops<float> {
+    using vec = __m512;
+    using mask = __mmask16;
+    static constexpr size_t width = 16;
+    SIMD_AVX512 SIMD_INLINE static vec load(const float* p) {
+        return _mm512_loadu_ps(p);
+    }
+    SIMD_AVX512 SIMD_INLINE static void store(float* p, vec v) {
+        _mm512_storeu_ps(p, v);
+    }
+    SIMD_AVX512 SIMD_INLINE static vec load(const float* p, mask m) {
+        return _mm512_maskz_loadu_ps(m, p);
+    }
+    SIMD_AVX512 SIMD_INLINE static void store(float* p, vec v, mask m) {
+        _mm512_mask_storeu_ps(p, m, v);
+    }
+    SIMD_AVX512 SIMD_INLINE static vec set1(float x) {
+        return _mm512_set1_ps(x);
+    }
+    SIMD_AVX512 SIMD_INLINE static vec nmadd(vec a, vec b, vec c) {
+        return _mm512_fnmadd_ps(a, b, c);
+    }
+};
+
+template <>
+struct avx512_ops<std::int32_t> {
+    using vec = __m512i;
+    using mask = __mmask16;
+    static constexpr size_t width = 16;
+    SIMD_AVX512 SIMD_INLINE static vec load(const std::int32_t* p) {
+        return _mm512_loadu_si512(p);
+    }
+    SIMD_AVX512 SIMD_INLINE static void store(std::int32_t* p, vec v) {
+        _mm512_storeu_si512(p, v);
+    }
+    SIMD_AVX512 SIMD_INLINE static vec load(const std::int32_t* p, mask m) {
+        return _mm512_maskz_loadu_epi32(m, p);
+    }
+    SIMD_AVX512 SIMD_INLINE static void store(std::int32_t* p, vec v,
+                                              mask m) {
+        _mm512_mask_storeu_epi32(p, m, v);
+    }
+    SIMD_AVX512 SIMD_INLINE static vec set1(std::int32_t x) {
+        return _mm512_set1_epi32(x);
+    }
+    SIMD_AVX512 SIMD_INLINE static vec nmadd(vec a, vec b, vec c) {
+        return _mm512_sub_epi32(c, _mm512_mullo_epi32(a, b));
+    }
+};
+
+// Two vectors per iteration to hide the FMA latency; the AVX2 tail is
+// scalar (at most 2 * width - 1 elements), the AVX-512 one masked.
+template <typename T>
+SIMD_AVX2 void row_update_avx2(T* dst, const T* src, T f, size_t n) {
+    using ops = avx2_ops<T>;
+    constexpr size_t w = ops::width;
+    const auto vf = ops::set1(f);
+    size_t j = 0;
+    for (; j + 2 * w <= n; j += 2 * w) {
+        auto d0 = ops::nmadd(ops::load(src + j), vf, ops::load(dst + j));
+        auto d1 =
+            ops::nmadd(ops::load(src + j + w), vf, ops::load(dst + j + w));
+        ops::store(dst + j, d0);
+        ops::store(dst + j + w, d1);
+    }
+    for (; j < n; ++j) {
+        dst[j] -= src[j] * f;
+    }
+}
+
+template <typename T>
+SIMD_AVX2 void row_update4_avx2(T* dst, const T* const* src, const T* f,
+                                size_t n) {
+    using ops = avx2_ops<T>;
+    constexpr size_t w = ops::width;
+    const auto f0 = ops::set1(f[0]);
+    const auto f1 = ops::set1(f[1]);
+    const auto f2 = ops::set1(f[2]);
+    const auto f3 = ops::set1(f[3]);
+    const T* s0 = src[0];
+    const T* s1 = src[1];
+    const T* s2 = src[2];
+    const T* s3 = src[3];
+    size_t j = 0;
+    for (; j + w <= n; j += w) {
+        auto d = ops::load(dst + j);
+        d = ops::nmadd(ops::load(s0 + j), f0, d);
+        d = ops::nmadd(ops::load(s1 + j), f1, d);
+        d = ops::nmadd(ops::load(s2 + j), f2, d);
+        d = ops::nmadd(ops::load(s3 + j), f3, d);
+        ops::store(dst + j, d);
+    }
+    for (; j < n; ++j) {
+        dst[j] = dst[j] - s0[j] * f[0] - s1[j] * f[1] - s2[j] * f[2] -
+                 s3[j] * f[3];
+    }
+}
+
+// Four destination rows share each load of the four source rows, which
+// makes the update bound by the FMA units rather than by loads.
+template <typename T>
+SIMD_AVX2 void row_update4x4_avx2(T* const* dst, const T* const* src,
+                                  const T (*f)[4], size_t n) {
+    using ops = avx2_ops<T>;
+    constexpr size_t w = ops::width;
+    size_t j = 0;
+    for (; j + w <= n; j += w) {
+        const auto s0 = ops::load(src[0] + j);
+        const auto s1 = ops::load(src[1] + j);
+        const auto s2 = ops::load(src[2] + j);
+        const auto s3 = ops::load(src[3] + j);
+        for (size_t r = 0; r < 4; ++r) {
+            auto d = ops::load(dst[r] + j);
+            d = ops::nmadd(s0, ops::set1(f[r][0]), d);
+            d = ops::nmadd(s1, ops::set1(f[r][1]), d);
+            d = ops::nmadd(s2, ops::set1(f[r][2]), d);
+            d = ops::nmadd(s3, ops::set1(f[r][3]), d);
+            ops::store(dst[r] + j, d);
+        }
+    }
+    for (; j < n; ++j) {
+        for (size_t r = 0; r < 4; ++r) {
+            dst[r][j] = dst[r][j] - src[0][j] * f[r][0] -
+                        src[1][j] * f[r][1] - src[2][j] * f[r][2] -
+                        src[3][j] * f[r][3];
+        }
+    }
+}
+
+template <typename T>
+SIMD_AVX512 void row_update_avx512(T* dst, const T* src, T f, size_t n) {
+    using ops = avx512_ops<T>;
+    constexpr size_t w = ops::width;
+    const auto vf = ops::set1(f);
+    size_t j = 0;
+    for (; j + 2 * w <= n; j += 2 * w) {
+        auto d0 = ops::nmadd(ops::load(src + j), vf, ops::load(dst + j));
+        auto d1 =
+            ops::nmadd(ops::load(src + j + w), vf, ops::load(dst + j + w));
+        ops::store(dst + j, d0);
+        ops::store(dst + j + w, d1);
+    }
+    for (; j < n; j += w) {
+        const auto m = static_cast<typename ops::mask>(
+            n - j >= w ? ~0u : (1u << (n - j)) - 1);
+        ops::store(dst + j,
+                   ops::nmadd(ops::load(src + j, m), vf, ops::load(dst + j, m)),
+                   m);
+    }
+}
+
+template <typename T>
+SIMD_AVX512 void row_update4_avx512(T* dst, const T* const* src, const T* f,
+                                    size_t n) {
+    using ops = avx512_ops<T>;
+    constexpr size_t w = ops::width;
+    const auto f0 = ops::set1(f[0]);
+    const auto f1 = ops::set1(f[1]);
+    const auto f2 = ops::set1(f[2]);
+    const auto f3 = ops::set1(f[3]);
+    const T* s0 = src[0];
+    const T* s1 = src[1];
+    const T* s2 = src[2];
+    const T* s3 = src[3];
+    for (size_t j = 0; j < n; j += w) {
+        const auto m = static_cast<typename ops::mask>(
+            n - j >= w ? ~0u : (1u << (n - j)) - 1);
+        auto d = ops::load(dst + j, m);
+        d = ops::nmadd(ops::load(s0 + j, m), f0, d);
+        d = ops::nmadd(ops::load(s1 + j, m), f1, d);
+        d = ops::nmadd(ops::load(s2 + j, m), f2, d);
+        d = ops::nmadd(ops::load(s3 + j, m), f3, d);
+        ops::store(dst + j, d, m);
+    }
+}
+
+template <typename T>
+SIMD_AVX512 void row_update4x4_avx512(T* const* dst, const T* const* src,
+                                      const T (*f)[4], size_t n) {
+    using ops = avx512_ops<T>;
+    constexpr size_t w = ops::width;
+    for (size_t j = 0; j < n; j += w) {
+        const auto m = static_cast<typename ops::mask>(
+            n - j >= w ? ~0u : (1u << (n - j)) - 1);
+        const auto s0 = ops::load(src[0] + j, m);
+        const auto s1 = ops::load(src[1] + j, m);
+        const auto s2 = ops::load(src[2] + j, m);
+        const auto s3 = ops::load(src[3] + j, m);
+        for (size_t r = 0; r < 4; ++r) {
+            auto d = ops::load(dst[r] + j, m);
+            d = ops::nmadd(s0, ops::set1(f[r][0]), d);
+            d = ops::nmadd(s1, ops::set1(f[r][1]), d);
+            d = ops::nmadd(s2, ops::set1(f[r][2]), d);
+            d = ops::nmadd(s3, ops::set1(f[r][3]), d);
+            ops::store(dst[r] + j, d, m);
+        }
+    }
+}
+
+SIMD_AVX2 inline void xor_row_avx2(std::uint64_t* dst,
+                                   const std::uint64_t* src, size_t n) {
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+        auto* d = reinterpret_cast<__m256i*>(dst + j);
+        auto* s = reinterpret_cast<const __m256i*>(src + j);
+        _mm256_storeu_si256(d, _mm256_xor_si256(_mm256_loadu_si256(d),
+                                                _mm256_loadu_si256(s)));
+    }
+    for (; j < n; ++j) {
+        dst[j] ^= src[j];
+    }
+}
+
+SIMD_AVX2 inline void xor_row4_avx2(std::uint64_t* dst,
+                                    const std::uint64_t* const* src,
+                                    size_t n) {
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+        auto load = [&](const std::uint64_t* p) SIMD_AVX2 {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + j));
+        };
+        const auto x = _mm256_xor_si256(_mm256_xor_si256(load(src[0]),
+                                                         load(src[1])),
+                                        _mm256_xor_si256(load(src[2]),
+                                                         load(src[3])));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + j),
+                            _mm256_xor_si256(load(dst), x));
+    }
+    for (; j < n; ++j) {
+        dst[j] ^= src[0][j] ^ src[1][j] ^ src[2][j] ^ src[3][j];
+    }
+}
+
+SIMD_AVX512 inline void xor_row_avx512(std::uint64_t* dst,
+                                       const std::uint64_t* src, size_t n) {
+    for (size_t j = 0; j < n; j += 8) {
+        const auto m = static_cast<__mmask8>(n - j >= 8 ? 0xff
+                                                        : (1u << (n - j)) - 1);
+        const auto d = _mm512_maskz_loadu_epi64(m, dst + j);
+        const auto s = _mm512_maskz_loadu_epi64(m, src + j);
+        _mm512_mask_storeu_epi64(dst + j, m, _mm512_xor_si512(d, s));
+    }
+}
+
+SIMD_AVX512 inline void xor_row4_avx512(std::uint64_t* dst,
+                                        const std::uint64_t* const* src,
+                                        size_t n) {
+    for (size_t j = 0; j < n; j += 8) {
+        const auto m = static_cast<__mmask8>(n - j >= 8 ? 0xff
+                                                        : (1u << (n - j)) - 1);
+        auto load = [&](const std::uint64_t* p) SIMD_AVX512 {
+            return _mm512_maskz_loadu_epi64(m, p + j);
+        };
+        // 0x96 is the truth table of a ^ b ^ c.
+        auto x = _mm512_ternarylogic_epi64(load(dst), load(src[0]),
+                                           load(src[1]), 0x96);
+        x = _mm512_ternarylogic_epi64(x, load(src[2]), load(src[3]), 0x96);
+        _mm512_mask_storeu_epi64(dst + j, m, x);
+    }
+}
+
+#endif  // SIMD_KERNELS_X86
+
+// dst[j] ^= src[j] for j < n.
+inline void xor_row(std::uint64_t* dst, const std::uint64_t* src, size_t n) {
+#ifdef SIMD_KERNELS_X86
+    switch (active_isa()) {
+        case isa::avx512:
+            return xor_row_avx512(dst, src, n);
+        case isa::avx2:
+            return xor_row_avx2(dst, src, n);
+        case isa::portable:
+            break;
+    }
+#endif
+    xor_row_portable(dst, src, n);
+}
+
+// dst[j] ^= src[0][j] ^ ... ^ src[3][j] for j < n.
+inline void xor_row4(std::uint64_t* dst, const std::uint64_t* const* src,
+                     size_t n) {
+#ifdef SIMD_KERNELS_X86
+    switch (active_isa()) {
+        case isa::avx512:
+            return xor_row4_avx512(dst, src, n);
+        case isa::avx2:
+            return xor_row4_avx2(dst, src, n);
+        case isa::portable:
+            break;
+    }
+#endif
+    xor_row4_portable(dst, src, n);
+}
+
+// dst[j] -= src[j] * f for j < n.
+template <typename T>
+    requires has_row_kernels<T>
+void row_update(T* dst, const T* src, T f, size_t n) {
+#ifdef SIMD_KERNELS_X86
+    switch (active_isa()) {
+        case isa::avx512:
+            return row_update_avx512(dst, src, f, n);
+        case isa::avx2:
+            return row_update_avx2(dst, src, f, n);
+        case isa::portable:
+            break;
+    }
+#endif
+    row_update_portable(dst, src, f, n);
+}
+
+// dst[j] -= src[0][j] * f[0] + ... + src[3][j] * f[3], subtracting in that
+// order.
+template <typename T>
+    requires has_row_kernels<T>
+void row_update4(T* dst, const T* const* src, const T* f, size_t n) {
+#ifdef SIMD_KERNELS_X86
+    switch (active_isa()) {
+        case isa::avx512:
+            return row_update4_avx512(dst, src, f, n);
+        case isa::avx2:
+            return row_update4_avx2(dst, src, f, n);
+        case isa::portable:
+            break;
+    }
+#endif
+    row_update4_portable(dst, src, f, n);
+}
+
+// row_update4() on four destination rows with their own factors f[r].
+template <typename T>
+    requires has_row_kernels<T>
+void row_update4x4(T* const* dst, const T* const* src, const T (*f)[4],
+                   size_t n) {
+#ifdef SIMD_KERNELS_X86
+    switch (active_isa()) {
+        case isa::avx512:
+            return row_update4x4_avx512(dst, src, f, n);
+        case isa::avx2:
+            return row_update4x4_avx2(dst, src, f, n);
+        case isa::portable:
+            break;
+    }
+#endif
+    row_update4x4_portable(dst, src, f, n);
+}
+
+}  // namespace simd
@@ -0,0 +1,240 @@
+#pragma once
+
+// Slab front-end for allocations smaller than the arena's Min block.
+//
+// Requests up to Min / 2 are served from size classes 16, 24, 32, 48, 64, 96,
+// ... (powers of two and the midpoints between them, so at most 33% internal
+// waste). Each slab is one Min-sized block taken from the arena: a header
+// with a free-slot bitmap followed by equally sized slots. Slabs with free
+// slots sit in a per-class list and full ones in another, so allocate and
+// free are O(1) apart from the bitmap scan, which starts at a hint word.
+// Larger requests go straight to the arena. All objects must be freed before
+// the slab_allocator is destroyed; it returns every slab to the arena.
+//
+// free() tells slots from arena blocks by their offset: arena blocks start on
+// a Min boundary, slots never do because the slab header comes first.
+// Not thread-safe, like buddy<>.
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+template <typename Arena>
+class slab_allocator {
+   public:
+    static constexpr size_t Min = size_t{1} << Arena::MinOrder;
+    static constexpr size_t MinClassSize = 16;
+    static constexpr size_t MaxClassSize = Min / 2;
+    static_assert(MaxClassSize >= MinClassSize * 4,
+                  "Min is too small for a slab front-end");
+
+    static constexpr size_t class_size(size_t index) noexcept {
+        if (index == 0) {
+            return MinClassSize;
+        }
+        // Odd indices are the midpoints 24, 48, 96, ..., even ones the powers
+        // of two 32, 64, 128, ...
+        size_t pow2 = MinClassSize << ((index + 1) / 2);
+        return index % 2 ? pow2 - pow2 / 4 : pow2;
+    }
+
+    static constexpr size_t class_index(size_t size) noexcept {
+        if (size <= MinClassSize) {
+            return 0;
+        }
+        size_t p = std::bit_width(size - 1);  // 2^(p-1) < size <= 2^p
+        size_t midpoint = (size_t{3} << (p - 2));
+        size_t pow2_index = 2 * (p - std::bit_width(MinClassSize - 1));
+        return size <= midpoint ? pow2_index - 1 : pow2_index;
+    }
+
+    static constexpr size_t ClassCount = class_index(MaxClassSize) + 1;
+
+    explicit slab_allocator(Arena& arena) : _arena{arena} {}
+
+    slab_allocator(const slab_allocator&) = delete;
+    slab_allocator& operator=(const slab_allocator&) = delete;
+
+    ~slab_allocator() {
+        for (auto* lists : {&_partial, &_full}) {
+            for (auto*& s : *lists) {
+                while (s) {
+                    assert(s->free_count == s->slot_count &&
+                           "slab_allocator destroyed with live objects");
+                    auto* next = s->next;
+                    _arena.free(s);
+                    s = next;
+                }
+            }
+        }
+    }
+
+    void* allocate(size_t size) {
+        if (size > MaxClassSize) {
+            return _arena.allocate(size);
+        }
+
+        const auto index = class_index(size);
+        auto* s = _partial[index];
+        if (!s) {
+            s = new_slab(index);
+            if (!s) {
+                return nullptr;
+            }
+        }
+
+        void* p = s->take();
+        if (s->free_count == 0) {
+            unlink(_partial, s);
+            push(_full, s);
+        }
+        return p;
+    }
+
+    void free(void* ptr) {
+        const auto offset =
+            static_cast<size_t>(static_cast<std::byte*>(ptr) - base());
+        if (offset % Min == 0) {
+            _arena.free(ptr);
+            return;
+        }
+
+        auto* s = reinterpret_cast<slab*>(base() + offset / Min * Min);
+        const bool was_full = s->free_count == 0;
+        s->put(ptr);
+        if (was_full) {
+            unlink(_full, s);
+            push(_partial, s);
+        }
+        if (s->free_count == s->slot_count && (s->prev || s->next)) {
+            // Empty and not the only slab of its class: give it back.
+            unlink(_partial, s);
+            --_slab_count;
+            _arena.free(s);
+        }
+    }
+
+    // Number of arena blocks currently used as slabs.
+    size_t slab_count() const noexcept { return _slab_count; }
+
+   private:
+    struct slab {
+        slab* prev;
+        slab* next;
+        std::uint32_t class_index;
+        std::uint32_t slot_size;
+        std::uint32_t slot_count;
+        std::uint32_t free_count;
+        std::uint32_t first_slot;  // Offset of slot 0 from the slab.
+        std::uint32_t hint;        // No free slot in bitmap words < hint.
+
+        // Bit set = slot free; slot_count bits right after the header.
+        std::uint64_t* bitmap() noexcept {
+            return reinterpret_cast<std::uint64_t*>(this + 1);
+        }
+
+        std::byte* slots() noexcept {
+            return reinterpret_cast<std::byte*>(this) + first_slot;
+        }
+
+        void* take() noexcept {
+            assert(free_count > 0);
+            auto* words = bitmap();
+            while (words[hint] == 0) {
+                ++hint;
+            }
+            auto bit = static_cast<size_t>(std::countr_zero(words[hint]));
+            words[hint] &= words[hint] - 1;
+            --free_count;
+            return slots() + (hint * 64 + bit) * slot_size;
+        }
+
+        void put(void* p) noexcept {
+            auto slot = static_cast<size_t>(static_cast<std::byte*>(p) -
+                                            slots()) /
+                        slot_size;
+            assert(slot < slot_count);
+            auto& word = bitmap()[slot / 64];
+            assert(!(word & (std::uint64_t{1} << (slot % 64))));
+            word |= std::uint64_t{1} << (slot % 64);
+            hint = std::min<std::uint32_t>(hint, slot / 64);
+            ++free_count;
+        }
+    };
+
+    static constexpr size_t header_size(size_t slots) noexcept {
+        return sizeof(slab) + (slots + 63) / 64 * 8;
+    }
+
+    // Largest slot count whose header and slots fit in one Min block, with
+    // slot 0 aligned to 16 bytes.
+    static constexpr size_t slot_count_for(size_t size) noexcept {
+        size_t n = Min / size;
+        while ((header_size(n) + 15) / 16 * 16 + n * size > Min) {
+            --n;
+        }
+        return n;
+    }
+
+    std::byte* base() noexcept { return _arena.base_pointer(); }
+
+    slab* new_slab(size_t index) {
+        void* block = _arena.allocate(Min);
+        if (!block) {
+            return nullptr;
+        }
+        ++_slab_count;
+
+        const size_t size = class_size(index);
+        const size_t count = slot_count_for(size);
+        auto* s = static_cast<slab*>(block);
+        s->prev = s->next = nullptr;
+        s->class_index = static_cast<std::uint32_t>(index);
+        s->slot_size = static_cast<std::uint32_t>(size);
+        s->slot_count = static_cast<std::uint32_t>(count);
+        s->free_count = s->slot_count;
+        s->first_slot =
+            static_cast<std::uint32_t>((header_size(count) + 15) / 16 * 16);
+        s->hint = 0;
+        for (size_t w = 0; w < (count + 63) / 64; ++w) {
+            size_t bits = std::min<size_t>(64, count - w * 64);
+            s->bitmap()[w] = bits == 64 ? ~std::uint64_t{0}
+                                        : (std::uint64_t{1} << bits) - 1;
+        }
+        push(_partial, s);
+        return s;
+    }
+
+    using slab_lists = std::array<slab*, ClassCount>;
+
+    void push(slab_lists& lists, slab* s) noexcept {
+        auto& head = lists[s->class_index];
+        s->prev = nullptr;
+        s->next = head;
+        if (head) {
+            head->prev = s;
+        }
+        head = s;
+    }
+
+    void unlink(slab_lists& lists, slab* s) noexcept {
+        if (s->prev) {
+            s->prev->next = s->next;
+        } else {
+            lists[s->class_index] = s->next;
+        }
+        if (s->next) {
+            s->next->prev = s->prev;
+        }
+        s->prev = s->next = nullptr;
+    }
+
+    Arena& _arena;
+    slab_lists _partial{};
+    slab_lists _full{};
+    size_t _slab_count = 0;
+};
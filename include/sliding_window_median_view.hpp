@@ -9,6 +9,14 @@
 #include <ranges>
 #include <vector>
 
+// The benchmarks are traced with -DMK_TRACE; otherwise this header stays
+// free of the trace registry.
+#ifdef MK_TRACE
+#include "trace_event.hpp"
+#elif !defined(MK_TRACE_SCOPE)
+#define MK_TRACE_SCOPE(name)
+#endif
+
 // Sliding median view using std::deque
 template <typename InputView>
 requires std::ranges::common_range<InputView>
@@ -290,6 +298,7 @@ namespace views {
 
 // Benchmark functions for each implementation
 double benchmark_deque(const std::vector<int>& data, std::size_t window_size) {
+    MK_TRACE_SCOPE("benchmark_deque");
     auto start = std::chrono::high_resolution_clock::now();
     
     std::vector<int> result;
@@ -304,6 +313,7 @@ double benchmark_deque(const std::vector<int>& data, std::size_t window_size) {
 }
 
 double benchmark_slide(const std::vector<int>& data, std::size_t window_size) {
+    MK_TRACE_SCOPE("benchmark_slide");
     auto start = std::chrono::high_resolution_clock::now();
     
     std::vector<int> result;
@@ -322,6 +332,7 @@ double benchmark_slide(const std::vector<int>& data, std::size_t window_size) {
 // Helper for array benchmark since window size is a template parameter
 template <std::size_t WindowSize>
 double benchmark_array_helper(const std::vector<int>& data) {
+    MK_TRACE_SCOPE("benchmark_array_helper");
     auto start = std::chrono::high_resolution_clock::now();
     
     std::vector<int> result;
@@ -0,0 +1,319 @@
+#pragma once
+
+// Sparse PA Q = LU factorization.
+//
+// The columns are taken in a fill-reducing order Q, by default a minimum
+// degree ordering of the pattern of A + A^T. Each column is then factored
+// left-looking (Gilbert and Peierls): the column of A is solved against the
+// L computed so far with a sparse triangular solve, which first finds the
+// rows the result can be nonzero in by a depth-first search through L and
+// then touches only those. The work per column is proportional to the
+// floating point operations it needs, not to n. The pivot is the largest
+// entry among the rows not yet pivotal, except that the diagonal is kept
+// when it is within `pivot_tolerance` of it, so that the symmetric ordering
+// still applies.
+
+#include "sparse_matrix.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Minimum degree ordering of the graph of A + A^T (the diagonal ignored).
+// The graph is eliminated explicitly, a vertex of least current degree at a
+// time, its neighbours becoming a clique; the edges added are exactly the
+// fill of a symmetric factorization in this order, so memory stays
+// proportional to the factors. Degrees are exact rather than approximated
+// as in AMD, and ties go to the lower index.
+template <typename T, sparse_layout Layout>
+std::vector<uint32_t> minimum_degree_ordering(
+    const compressed_matrix<T, Layout>& A) {
+    assert(A.rows() == A.cols());
+    const size_t n = A.rows();
+
+    std::vector<std::vector<uint32_t>> adjacent(n);
+    for (size_t o = 0; o < n; ++o) {
+        for (auto i : A.indices(o)) {
+            if (i != o) {
+                adjacent[o].push_back(i);
+                adjacent[i].push_back(static_cast<uint32_t>(o));
+            }
+        }
+    }
+    for (auto& a : adjacent) {
+        std::ranges::sort(a);
+        a.erase(std::unique(a.begin(), a.end()), a.end());
+    }
+
+    using entry = std::pair<size_t, uint32_t>;  // degree, vertex
+    std::priority_queue<entry, std::vector<entry>, std::greater<>> queue;
+    for (uint32_t v = 0; v < n; ++v) {
+        queue.emplace(adjacent[v].size(), v);
+    }
+
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    std::vector<bool> eliminated(n);
+    std::vector<uint32_t> merged;
+    while (!queue.empty()) {
+        auto [degree, v] = queue.top();
+        queue.pop();
+        if (eliminated[v] || degree != adjacent[v].size()) {
+            continue;  // stale
+        }
+        eliminated[v] = true;
+        order.push_back(v);
+
+        auto& clique = adjacent[v];
+        for (auto u : clique) {
+            auto& a = adjacent[u];
+            merged.clear();
+            std::ranges::set_union(a, clique, std::back_inserter(merged));
+            std::erase_if(merged, [&](uint32_t w) { return w == u || w == v; });
+            a.swap(merged);
+            queue.emplace(a.size(), u);
+        }
+        std::vector<uint32_t>().swap(clique);
+    }
+    return order;
+}
+
+template <typename T>
+class sparse_lu {
+   public:
+    enum class ordering { natural, minimum_degree };
+
+    explicit sparse_lu(const csc_matrix<T>& A,
+                       ordering order = ordering::minimum_degree,
+                       double pivot_tolerance = 0.001) {
+        assert(A.rows() == A.cols());
+        const size_t n = A.rows();
+        if (order == ordering::minimum_degree) {
+            _col_order = minimum_degree_ordering(A);
+        } else {
+            _col_order.resize(n);
+            std::iota(_col_order.begin(), _col_order.end(), 0u);
+        }
+        factor(A, pivot_tolerance);
+    }
+
+    size_t size() const noexcept { return _row_pivot.size(); }
+
+    // Stops at the first column without a pivot; solving needs !singular().
+    bool singular() const noexcept { return _singular; }
+
+    // L with a unit diagonal stored first in each column, and U with the
+    // diagonal last, both in pivot order.
+    const csc_matrix<T>& lower() const noexcept { return _L; }
+    const csc_matrix<T>& upper() const noexcept { return _U; }
+
+    // Row k of PAQ is row row_order()[k] of A, column k is column
+    // col_order()[k].
+    const std::vector<uint32_t>& row_order() const noexcept {
+        return _row_order;
+    }
+    const std::vector<uint32_t>& col_order() const noexcept {
+        return _col_order;
+    }
+
+    size_t fill() const noexcept { return _L.nonzeros() + _U.nonzeros(); }
+
+    void solve_in_place(std::span<T> b) const {
+        assert(!_singular && b.size() == size());
+        const size_t n = size();
+        std::vector<T> y(n);
+        for (size_t k = 0; k < n; ++k) {
+            y[k] = b[_row_order[k]];
+        }
+        for (size_t k = 0; k < n; ++k) {
+            auto idx = _L.indices(k);
+            auto val = _L.values(k);
+            for (size_t p = 1; p < idx.size(); ++p) {
+                y[idx[p]] -= val[p] * y[k];
+            }
+        }
+        for (size_t k = n; k-- > 0;) {
+            auto idx = _U.indices(k);
+            auto val = _U.values(k);
+            y[k] /= val.back();
+            for (size_t p = 0; p + 1 < idx.size(); ++p) {
+                y[idx[p]] -= val[p] * y[k];
+            }
+        }
+        for (size_t k = 0; k < n; ++k) {
+            b[_col_order[k]] = y[k];
+        }
+    }
+
+    std::vector<T> solve(std::span<const T> b) const {
+        std::vector<T> x(b.begin(), b.end());
+        solve_in_place(x);
+        return x;
+    }
+
+   private:
+    static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+    void factor(const csc_matrix<T>& A, double pivot_tolerance) {
+        using std::abs;
+        const size_t n = A.rows();
+        _row_pivot.assign(n, none);
+
+        // L and U grow a column at a time. L's row indices are rows of A
+        // until every pivot is known, then renumbered.
+        std::vector<size_t> l_starts{0}, u_starts{0};
+        std::vector<uint32_t> l_rows, u_rows;
+        std::vector<T> l_values, u_values;
+        l_rows.reserve(2 * A.nonzeros());
+        l_values.reserve(2 * A.nonzeros());
+        u_rows.reserve(2 * A.nonzeros());
+        u_values.reserve(2 * A.nonzeros());
+
+        std::vector<T> x(n);  // dense work column, zero between columns
+        std::vector<uint32_t> reach, stack;
+        std::vector<size_t> next_child(n);
+        std::vector<uint32_t> marked(n, none);
+
+        for (size_t k = 0; k < n; ++k) {
+            const uint32_t col = _col_order[k];
+
+            // Rows reachable from the column's pattern through L, in
+            // topological order (reversed at the end of reach).
+            reach.clear();
+            for (auto start : A.indices(col)) {
+                if (marked[start] == k) continue;
+                marked[start] = static_cast<uint32_t>(k);
+                stack.assign(1, start);
+                next_child[start] = 0;
+                while (!stack.empty()) {
+                    const uint32_t i = stack.back();
+                    const uint32_t j = _row_pivot[i];
+                    bool descended = false;
+                    if (j != none) {
+                        const size_t begin = l_starts[j] + 1;  // skip diagonal
+                        const size_t end = l_starts[j + 1];
+                        for (size_t& c = next_child[i]; begin + c < end;) {
+                            const uint32_t child = l_rows[begin + c++];
+                            if (marked[child] == k) continue;
+                            marked[child] = static_cast<uint32_t>(k);
+                            next_child[child] = 0;
+                            stack.push_back(child);
+                            descended = true;
+                            break;
+                        }
+                    }
+                    if (!descended) {
+                        stack.pop_back();
+                        reach.push_back(i);
+                    }
+                }
+            }
+
+            // x = L \ A(:, col), visiting the pivotal rows in topological
+            // order.
+            auto a_rows = A.indices(col);
+            auto a_values = A.values(col);
+            for (size_t p = 0; p < a_rows.size(); ++p) {
+                x[a_rows[p]] = a_values[p];
+            }
+            for (size_t r = reach.size(); r-- > 0;) {
+                const uint32_t i = reach[r];
+                const uint32_t j = _row_pivot[i];
+                if (j == none) continue;
+                const T xi = x[i];
+                for (size_t p = l_starts[j] + 1; p < l_starts[j + 1]; ++p) {
+                    x[l_rows[p]] -= l_values[p] * xi;
+                }
+            }
+
+            // U(:, k) from the pivotal rows, the pivot from the others.
+            uint32_t pivot_row = none;
+            T largest{};
+            for (auto i : reach) {
+                if (_row_pivot[i] != none) {
+                    u_rows.push_back(_row_pivot[i]);
+                    u_values.push_back(x[i]);
+                } else if (abs(x[i]) > largest) {
+                    largest = abs(x[i]);
+                    pivot_row = i;
+                }
+            }
+            if (pivot_row == none || largest == T{}) {
+                _singular = true;
+                for (auto i : reach) x[i] = T{};
+                break;
+            }
+            if (_row_pivot[col] == none && x[col] != T{} &&
+                abs(x[col]) >= pivot_tolerance * largest) {
+                pivot_row = col;
+            }
+            const T pivot = x[pivot_row];
+            _row_pivot[pivot_row] = static_cast<uint32_t>(k);
+            u_rows.push_back(static_cast<uint32_t>(k));
+            u_values.push_back(pivot);
+            u_starts.push_back(u_rows.size());
+
+            l_rows.push_back(pivot_row);
+            l_values.push_back(T{1});
+            for (auto i : reach) {
+                if (_row_pivot[i] == none) {
+                    l_rows.push_back(i);
+                    l_values.push_back(x[i] / pivot);
+                }
+                x[i] = T{};
+            }
+            l_starts.push_back(l_rows.size());
+        }
+        if (_singular) {
+            return;
+        }
+
+        _row_order.resize(n);
+        for (uint32_t i = 0; i < n; ++i) {
+            _row_order[_row_pivot[i]] = i;
+        }
+        for (auto& i : l_rows) {
+            i = _row_pivot[i];
+        }
+        // The columns come out in reach order. Sorted, L's diagonal is first
+        // and U's last, as both are the extreme pivot step in the column.
+        std::vector<std::pair<uint32_t, T>> column;
+        auto sort_column = [&](std::vector<uint32_t>& rows,
+                               std::vector<T>& values, size_t begin,
+                               size_t end) {
+            column.clear();
+            for (size_t p = begin; p < end; ++p) {
+                column.emplace_back(rows[p], values[p]);
+            }
+            std::ranges::sort(column, {}, &std::pair<uint32_t, T>::first);
+            for (size_t p = begin; p < end; ++p) {
+                std::tie(rows[p], values[p]) = column[p - begin];
+            }
+        };
+        for (size_t k = 0; k < n; ++k) {
+            sort_column(l_rows, l_values, l_starts[k], l_starts[k + 1]);
+            sort_column(u_rows, u_values, u_starts[k], u_starts[k + 1]);
+        }
+        _L = csc_matrix<T>(n, n, std::move(l_starts), std::move(l_rows),
+                           std::move(l_values));
+        _U = csc_matrix<T>(n, n, std::move(u_starts), std::move(u_rows),
+                           std::move(u_values));
+    }
+
+    std::vector<uint32_t> _col_order;
+    std::vector<uint32_t> _row_order;
+    std::vector<uint32_t> _row_pivot;  // row of A -> pivot step, or none
+    csc_matrix<T> _L;
+    csc_matrix<T> _U;
+    bool _singular = false;
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+// Compressed sparse matrices.
+//
+// A compressed matrix stores, for each outer index, the inner indices and
+// values of its nonzeros, contiguous and sorted: rows of column indices for
+// CSR, columns of row indices for CSC. Converting between the two is a
+// transpose of the storage, done with one counting pass.
+
+#include "dense_matrix.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <vector>
+
+enum class sparse_layout { csr, csc };
+
+template <typename T>
+struct sparse_entry {
+    uint32_t row;
+    uint32_t col;
+    T value;
+};
+
+template <typename T, sparse_layout Layout>
+class compressed_matrix {
+   public:
+    using value_type = T;
+    static constexpr sparse_layout layout = Layout;
+
+    compressed_matrix() = default;
+
+    // From entries in any order; duplicates are summed, explicit zeros kept.
+    compressed_matrix(size_t rows, size_t cols,
+                      std::vector<sparse_entry<T>> entries)
+        : _rows{rows}, _cols{cols} {
+        auto key = [](const sparse_entry<T>& e) {
+            return Layout == sparse_layout::csr
+                       ? std::pair{e.row, e.col}
+                       : std::pair{e.col, e.row};
+        };
+        std::ranges::sort(entries, {}, key);
+        _starts.assign(outer_size() + 1, 0);
+        for (const auto& e : entries) {
+            assert(e.row < rows && e.col < cols);
+            auto [outer, inner] = key(e);
+            if (!_indices.empty() && _starts[outer + 1] > 0 &&
+                _indices.back() == inner) {
+                _values.back() += e.value;
+                continue;
+            }
+            _indices.push_back(inner);
+            _values.push_back(e.value);
+            ++_starts[outer + 1];
+        }
+        std::partial_sum(_starts.begin(), _starts.end(), _starts.begin());
+    }
+
+    // Takes the arrays as they are; indices must be sorted within each outer
+    // index and starts must have outer_size() + 1 entries.
+    compressed_matrix(size_t rows, size_t cols, std::vector<size_t> starts,
+                      std::vector<uint32_t> indices, std::vector<T> values)
+        : _rows{rows},
+          _cols{cols},
+          _starts{std::move(starts)},
+          _indices{std::move(indices)},
+          _values{std::move(values)} {
+        assert(_starts.size() == outer_size() + 1);
+        assert(_indices.size() == _starts.back());
+        assert(_values.size() == _indices.size());
+    }
+
+    size_t rows() const noexcept { return _rows; }
+    size_t cols() const noexcept { return _cols; }
+    size_t nonzeros() const noexcept { return _indices.size(); }
+
+    // Rows for CSR, columns for CSC.
+    size_t outer_size() const noexcept {
+        return Layout == sparse_layout::csr ? _rows : _cols;
+    }
+
+    std::span<const uint32_t> indices(size_t outer) const noexcept {
+        return {_indices.data() + _starts[outer],
+                _starts[outer + 1] - _starts[outer]};
+    }
+    std::span<const T> values(size_t outer) const noexcept {
+        return {_values.data() + _starts[outer],
+                _starts[outer + 1] - _starts[outer]};
+    }
+    std::span<T> values(size_t outer) noexcept {
+        return {_values.data() + _starts[outer],
+                _starts[outer + 1] - _starts[outer]};
+    }
+
+    const std::vector<size_t>& starts() const noexcept { return _starts; }
+    const std::vector<uint32_t>& indices() const noexcept { return _indices; }
+    const std::vector<T>& values() const noexcept { return _values; }
+
+    // y = Ax.
+    void multiply(std::span<const T> x, std::span<T> y) const {
+        assert(x.size() == _cols && y.size() == _rows);
+        if constexpr (Layout == sparse_layout::csr) {
+            for (size_t i = 0; i < _rows; ++i) {
+                T sum{};
+                auto idx = indices(i);
+                auto val = values(i);
+                for (size_t p = 0; p < idx.size(); ++p) {
+                    sum += val[p] * x[idx[p]];
+                }
+                y[i] = sum;
+            }
+        } else {
+            std::ranges::fill(y, T{});
+            for (size_t j = 0; j < _cols; ++j) {
+                auto idx = indices(j);
+                auto val = values(j);
+                for (size_t p = 0; p < idx.size(); ++p) {
+                    y[idx[p]] += val[p] * x[j];
+                }
+            }
+        }
+    }
+
+    dense_matrix<T> to_dense() const {
+        dense_matrix<T> out(_rows, _cols);
+        for (size_t o = 0; o < outer_size(); ++o) {
+            auto idx = indices(o);
+            auto val = values(o);
+            for (size_t p = 0; p < idx.size(); ++p) {
+                if constexpr (Layout == sparse_layout::csr) {
+                    out[o][idx[p]] = val[p];
+                } else {
+                    out[idx[p]][o] = val[p];
+                }
+            }
+        }
+        return out;
+    }
+
+   private:
+    size_t _rows = 0;
+    size_t _cols = 0;
+    std::vector<size_t> _starts = std::vector<size_t>(1, 0);
+    std::vector<uint32_t> _indices;
+    std::vector<T> _values;
+};
+
+template <typename T>
+using csr_matrix = compressed_matrix<T, sparse_layout::csr>;
+template <typename T>
+using csc_matrix = compressed_matrix<T, sparse_layout::csc>;
+
+namespace detail {
+// The same matrix in the other layout: the storage transposed, with the
+// inner indices coming out sorted because the outer ones are visited in
+// order.
+template <typename Out, typename In>
+Out convert_layout(const In& in) {
+    const size_t inner_size =
+        In::layout == sparse_layout::csr ? in.cols() : in.rows();
+    std::vector<size_t> starts(inner_size + 1, 0);
+    for (auto i : in.indices()) {
+        ++starts[i + 1];
+    }
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+
+    std::vector<size_t> next(starts.begin(), starts.end() - 1);
+    std::vector<uint32_t> indices(in.nonzeros());
+    std::vector<typename In::value_type> values(in.nonzeros());
+    for (size_t o = 0; o < in.outer_size(); ++o) {
+        auto idx = in.indices(o);
+        auto val = in.values(o);
+        for (size_t p = 0; p < idx.size(); ++p) {
+            const size_t q = next[idx[p]]++;
+            indices[q] = static_cast<uint32_t>(o);
+            values[q] = val[p];
+        }
+    }
+    return Out(in.rows(), in.cols(), std::move(starts), std::move(indices),
+               std::move(values));
+}
+}  // namespace detail
+
+template <typename T>
+csc_matrix<T> to_csc(const csr_matrix<T>& A) {
+    return detail::convert_layout<csc_matrix<T>>(A);
+}
+
+template <typename T>
+csr_matrix<T> to_csr(const csc_matrix<T>& A) {
+    return detail::convert_layout<csr_matrix<T>>(A);
+}
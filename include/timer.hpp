@@ -1,6 +1,11 @@
 #pragma once
 
+#include "perf_counters.hpp"
+#include "trace_event.hpp"
+#include "tsc_clock.hpp"
+
 #include <chrono>
+#include <cstddef>
 #include <print>
 #include <string>
 
@@ -9,19 +14,73 @@ namespace mk {
 struct timer {
     using clock = std::chrono::steady_clock;
 
-    timer(std::string name) : _name{std::move(name)}, _start{clock::now()} {}
+    // What to do with a scope; `trace` records begin/end events for
+    // trace::write_json, `counters` adds IPC and cache/branch misses (per
+    // element, if given) from perf::thread_counters to the printed line.
+    enum options : unsigned {
+        print = 1u << 0,
+        trace = 1u << 1,
+        counters = 1u << 2,
+    };
+
+    timer(std::string name, unsigned opts = print, std::size_t elements = 0)
+        : _name{std::move(name)}, _opts{opts}, _elements{elements} {
+        if (_opts & trace) {
+            trace::begin(_name);
+        }
+        if (_opts & counters) {
+            _counters_start = perf::thread_counters().read();
+        }
+        _start = clock::now();
+    }
     ~timer() {
         namespace chr = std::chrono;
         using presentation_unit = chr::duration<float, std::milli>;
 
         auto stop = clock::now();
-        auto elapsed = stop - _start;
-        std::print("* {} elapsed: {}\n", _name,
-                   chr::duration_cast<presentation_unit>(elapsed));
+        perf::reading counted;
+        if (_opts & counters) {
+            counted = perf::thread_counters().read() - _counters_start;
+        }
+        if (_opts & trace) {
+            trace::end(_name);
+        }
+        if (_opts & print) {
+            auto elapsed = stop - _start;
+            std::print("* {} elapsed: {}", _name,
+                       chr::duration_cast<presentation_unit>(elapsed));
+            if (_opts & counters) {
+                print_counters(counted);
+            }
+            std::print("\n");
+        }
     }
 
    private:
+    void print_counters(const perf::reading& r) const {
+        if (!r.valid) {
+            std::print(" (perf counters unavailable: {})",
+                       perf::thread_counters().error());
+            return;
+        }
+        if (auto ipc = r.ipc()) {
+            std::print(", IPC: {:.2f}", *ipc);
+        }
+        auto print_event = [&](perf::event e, const char* label) {
+            if (auto v = r.per_element(e, _elements)) {
+                std::print(", {}/elem: {:.4f}", label, *v);
+            } else if (auto v = r.get(e)) {
+                std::print(", {}: {}", label, *v);
+            }
+        };
+        print_event(perf::event::llc_misses, "LLC misses");
+        print_event(perf::event::branch_misses, "branch misses");
+    }
+
     std::string _name;
+    unsigned _opts;
+    std::size_t _elements;
+    perf::reading _counters_start;
     clock::time_point _start;
 };
 
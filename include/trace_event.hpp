@@ -0,0 +1,251 @@
+#pragma once
+
+// Timeline recording in the Chrome trace_event format (opens in Perfetto and
+// chrome://tracing).
+//
+// Every thread appends begin/end events to its own fixed-size ring buffer
+// without locking; a full buffer drops new events (and counts them) rather
+// than blocking the producer. When a thread exits, its pending events are
+// copied out and the buffer is kept for the next new thread, so only as many
+// buffers exist as threads ever ran at once. write_json() drains all
+// buffers, including the events of threads that have already exited. If
+// MK_TRACE_FILE is set in the environment, the trace is also written there
+// when the program exits.
+//
+// MK_TRACE_SCOPE(name) traces the enclosing scope when built with -DMK_TRACE
+// and expands to nothing otherwise.
+
+#include "tsc_clock.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <string_view>
+#include <vector>
+
+#ifndef MK_TRACE_BUFFER_EVENTS
+#define MK_TRACE_BUFFER_EVENTS (1u << 16)
+#endif
+
+namespace mk::trace {
+
+struct event {
+    static constexpr std::size_t max_name = 47;
+
+    tsc_clock::rep ts;
+    char phase;  // 'B' or 'E'
+    std::array<char, max_name> name;
+};
+
+// Single producer (the owning thread), single consumer (the flusher).
+class ring_buffer {
+   public:
+    static constexpr std::size_t capacity = MK_TRACE_BUFFER_EVENTS;
+    static_assert(std::has_single_bit(capacity));
+
+    explicit ring_buffer(std::uint32_t tid) : _tid{tid} {}
+
+    // Hands a drained buffer to a new thread.
+    void reset(std::uint32_t tid) noexcept {
+        _tid = tid;
+        _dropped.store(0, std::memory_order_relaxed);
+    }
+
+    void push(char phase, std::string_view name,
+              tsc_clock::rep ts) noexcept {
+        auto head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == capacity) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto& e = _events[head & (capacity - 1)];
+        e.ts = ts;
+        e.phase = phase;
+        auto n = std::min(name.size(), event::max_name - 1);
+        std::copy_n(name.data(), n, e.name.data());
+        e.name[n] = '\0';
+        _head.store(head + 1, std::memory_order_release);
+    }
+
+    template <typename F>
+    void drain(F&& f) {
+        auto tail = _tail.load(std::memory_order_relaxed);
+        auto head = _head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            f(_events[tail & (capacity - 1)]);
+        }
+        _tail.store(tail, std::memory_order_release);
+    }
+
+    std::uint32_t tid() const noexcept { return _tid; }
+    std::uint64_t dropped() const noexcept {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+   private:
+    alignas(64) std::atomic<std::uint64_t> _head{0};
+    alignas(64) std::atomic<std::uint64_t> _tail{0};
+    std::atomic<std::uint64_t> _dropped{0};
+    std::uint32_t _tid;
+    std::array<event, capacity> _events;
+};
+
+void write_json(std::FILE* out);
+
+namespace detail {
+
+struct exited_thread {
+    std::uint32_t tid;
+    std::vector<event> events;
+};
+
+struct collector {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ring_buffer>> buffers;
+    std::vector<std::unique_ptr<ring_buffer>> spare;
+    std::vector<exited_thread> exited;
+    std::uint64_t exited_dropped = 0;
+    std::uint32_t next_tid = 1;
+    tsc_clock::rep epoch = tsc_clock::ticks();
+
+    ~collector() {
+        if (const char* path = std::getenv("MK_TRACE_FILE")) {
+            if (auto* out = std::fopen(path, "w")) {
+                write_json(out);
+                std::fclose(out);
+            }
+        }
+    }
+
+    ring_buffer* add_thread() {
+        std::lock_guard lock{mutex};
+        const auto tid = next_tid++;
+        if (!spare.empty()) {
+            buffers.push_back(std::move(spare.back()));
+            spare.pop_back();
+            buffers.back()->reset(tid);
+            return buffers.back().get();
+        }
+        return buffers.emplace_back(std::make_unique<ring_buffer>(tid)).get();
+    }
+
+    // Called by the owning thread on exit; it pushes no more events.
+    void remove_thread(ring_buffer* buffer) {
+        std::lock_guard lock{mutex};
+        auto it = std::ranges::find(buffers, buffer,
+                                    &std::unique_ptr<ring_buffer>::get);
+        auto& t = exited.emplace_back(buffer->tid());
+        buffer->drain([&](const event& e) { t.events.push_back(e); });
+        exited_dropped += buffer->dropped();
+        spare.push_back(std::move(*it));
+        buffers.erase(it);
+    }
+};
+
+inline collector& global_collector() {
+    static collector c;
+    return c;
+}
+
+struct thread_buffer {
+    ring_buffer* buffer = global_collector().add_thread();
+
+    thread_buffer() = default;
+    thread_buffer(const thread_buffer&) = delete;
+    thread_buffer& operator=(const thread_buffer&) = delete;
+    ~thread_buffer() { global_collector().remove_thread(buffer); }
+};
+
+inline ring_buffer& local_buffer() {
+    thread_local thread_buffer t;
+    return *t.buffer;
+}
+
+inline void print_escaped(std::FILE* out, std::string_view s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', out);
+        }
+        std::fputc(c, out);
+    }
+}
+
+}  // namespace detail
+
+inline void begin(std::string_view name) {
+    detail::local_buffer().push('B', name, tsc_clock::ticks());
+}
+
+inline void end(std::string_view name) {
+    detail::local_buffer().push('E', name, tsc_clock::ticks());
+}
+
+struct scope {
+    explicit scope(std::string_view name) : _name{name} { begin(_name); }
+    ~scope() { end(_name); }
+
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+
+   private:
+    std::string_view _name;
+};
+
+// Drains every buffer into `out` as a {"traceEvents": [...]} document.
+inline void write_json(std::FILE* out) {
+    auto& c = detail::global_collector();
+    std::lock_guard lock{c.mutex};
+
+    std::uint64_t dropped = c.exited_dropped;
+    const char* separator = "";
+    auto print_thread = [&](std::uint32_t tid) {
+        std::print(out,
+                   "{}{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                   "\"tid\": {}, \"args\": {{\"name\": \"thread {}\"}}}}",
+                   separator, tid, tid);
+        separator = ",\n";
+    };
+    auto print_event = [&](std::uint32_t tid, const event& e) {
+        auto us = tsc_clock::to_duration(e.ts - c.epoch).count() / 1e3;
+        std::print(out, "{}{{\"name\": \"", separator);
+        detail::print_escaped(out, e.name.data());
+        std::print(out,
+                   "\", \"ph\": \"{}\", \"ts\": {:.3f}, \"pid\": 1, "
+                   "\"tid\": {}}}",
+                   e.phase, us, tid);
+    };
+
+    std::print(out, "{{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    for (const auto& t : c.exited) {
+        print_thread(t.tid);
+        for (const auto& e : t.events) {
+            print_event(t.tid, e);
+        }
+    }
+    c.exited.clear();
+    for (const auto& buffer : c.buffers) {
+        print_thread(buffer->tid());
+        buffer->drain([&](const event& e) { print_event(buffer->tid(), e); });
+        dropped += buffer->dropped();
+    }
+    std::print(out, "\n], \"otherData\": {{\"dropped_events\": {}}}}}\n",
+               dropped);
+}
+
+}  // namespace mk::trace
+
+#ifdef MK_TRACE
+#define MK_TRACE_CONCAT_IMPL(a, b) a##b
+#define MK_TRACE_CONCAT(a, b) MK_TRACE_CONCAT_IMPL(a, b)
+#define MK_TRACE_SCOPE(name) \
+    const ::mk::trace::scope MK_TRACE_CONCAT(mk_trace_scope_, __LINE__) { name }
+#else
+#define MK_TRACE_SCOPE(name)
+#endif
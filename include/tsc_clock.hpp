@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace mk {
+
+// Raw time stamp counter, for when even steady_clock::now() is too expensive.
+// Assumes an invariant TSC (constant rate, synchronized across cores), which
+// holds for any x86 CPU of the last decade. Other targets fall back to
+// steady_clock ticks.
+struct tsc_clock {
+    using rep = std::uint64_t;
+
+    static rep ticks() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    // Calibrated once (~10 ms) against steady_clock on first use, so keep it
+    // out of the measured code.
+    static double ns_per_tick() {
+        static const double ratio = calibrate();
+        return ratio;
+    }
+
+    static std::chrono::duration<double, std::nano> to_duration(rep ticks) {
+        return std::chrono::duration<double, std::nano>{ticks * ns_per_tick()};
+    }
+
+   private:
+    static double calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+        using clock = std::chrono::steady_clock;
+        auto t0 = clock::now();
+        auto c0 = ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        auto t1 = clock::now();
+        auto c1 = ticks();
+        std::chrono::duration<double, std::nano> elapsed = t1 - t0;
+        return elapsed.count() / static_cast<double>(c1 - c0);
+#else
+        using period = std::chrono::steady_clock::period;
+        return 1e9 * period::num / period::den;
+#endif
+    }
+};
+
+}  // namespace mk
@@ -0,0 +1,615 @@
+// Benchmarks for buddy<>, with malloc as the baseline. Prints CSV.
+//
+//     buddy_allocator_bench [latency|scaling|pmr|slab|rss|stats|realloc]...
+//
+// latency: per-operation latency under randomized alloc/free traces.
+// scaling: alloc/free throughput of concurrent_buddy from 1 to N threads.
+// pmr:     std::pmr containers on buddy, monotonic and the default resource.
+// slab:    small allocations on buddy with and without the slab front-end.
+// rss:     startup time and resident memory of vector vs mmap backed arenas.
+// stats:   buddy_stats snapshots (JSON lines) halfway through the latency
+//          traces.
+// realloc: growing buffers with buddy reallocate, allocate+copy and realloc.
+
+#include <fmt/format.h>
+
+#include "allocation_trace.hpp"
+#include "buddy_allocator.hpp"
+#include "buddy_memory_resource.hpp"
+#include "concurrent_buddy.hpp"
+#include "slab_allocator.hpp"
+#include "tsc_clock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct latency_summary {
+    size_t count = 0;
+    size_t failed = 0;
+    double mean_ns = 0;
+    double p50_ns = 0;
+    double p90_ns = 0;
+    double p99_ns = 0;
+    double p999_ns = 0;
+    double max_ns = 0;
+};
+
+static latency_summary summarize(std::vector<mk::tsc_clock::rep>& ticks,
+                                 size_t failed) {
+    latency_summary s;
+    s.count = ticks.size();
+    s.failed = failed;
+    if (ticks.empty()) {
+        return s;
+    }
+    std::ranges::sort(ticks);
+    auto ns = [](mk::tsc_clock::rep t) {
+        return mk::tsc_clock::to_duration(t).count();
+    };
+    auto at = [&](double q) {
+        return ns(ticks[std::min(ticks.size() - 1,
+                                 static_cast<size_t>(q * ticks.size()))]);
+    };
+    mk::tsc_clock::rep total = 0;
+    for (auto t : ticks) {
+        total += t;
+    }
+    s.mean_ns = ns(total) / ticks.size();
+    s.p50_ns = at(0.50);
+    s.p90_ns = at(0.90);
+    s.p99_ns = at(0.99);
+    s.p999_ns = at(0.999);
+    s.max_ns = ns(ticks.back());
+    return s;
+}
+
+template <typename Allocator>
+static void run_trace(std::string_view allocator_name,
+                      std::string_view trace_name,
+                      const std::vector<trace_op>& trace, Allocator& a) {
+    using mk::tsc_clock;
+
+    std::vector<void*> slots(trace_slot_count(trace), nullptr);
+    std::vector<tsc_clock::rep> alloc_ticks;
+    std::vector<tsc_clock::rep> free_ticks;
+    alloc_ticks.reserve(trace.size());
+    free_ticks.reserve(trace.size());
+    size_t failed = 0;
+
+    for (const auto& op : trace) {
+        if (op.op == trace_op::alloc) {
+            auto start = tsc_clock::ticks();
+            void* p = a.allocate(op.size);
+            auto stop = tsc_clock::ticks();
+            alloc_ticks.push_back(stop - start);
+            failed += p == nullptr;
+            slots[op.slot] = p;
+        } else if (void* p = slots[op.slot]) {
+            auto start = tsc_clock::ticks();
+            a.free(p);
+            auto stop = tsc_clock::ticks();
+            free_ticks.push_back(stop - start);
+            slots[op.slot] = nullptr;
+        }
+    }
+
+    auto print_row = [&](std::string_view op, const latency_summary& s) {
+        fmt::print("{},{},{},{},{},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f}\n",
+                   allocator_name, trace_name, op, s.count, s.failed,
+                   s.mean_ns, s.p50_ns, s.p90_ns, s.p99_ns, s.p999_ns,
+                   s.max_ns);
+    };
+    print_row("alloc", summarize(alloc_ticks, failed));
+    print_row("free", summarize(free_ticks, 0));
+}
+
+struct malloc_allocator {
+    void* allocate(size_t sz) { return std::malloc(sz); }
+    void free(void* p) { std::free(p); }
+};
+
+static void run_latency() {
+    constexpr size_t Min = 1 << 6;
+    constexpr size_t Max = 1 << 26;
+    using arena = buddy<Min, Max>;
+
+    struct named_trace {
+        std::string_view name;
+        std::vector<trace_op> ops;
+    };
+    const named_trace traces[] = {
+        {"random", random_trace(1'000'000, 4'000, 16, 64 << 10, 42)},
+        {"fragmented",
+         fragmented_trace(1'000'000, Max / Min / 2, Min, /*seed=*/43)},
+    };
+
+    fmt::print(
+        "allocator,trace,op,count,failed,mean_ns,p50_ns,p90_ns,p99_ns,"
+        "p999_ns,max_ns\n");
+    for (const auto& [name, ops] : traces) {
+        auto mem = std::make_unique<arena>(Max);
+        run_trace("buddy", name, ops, *mem);
+
+        malloc_allocator m;
+        run_trace("malloc", name, ops, m);
+    }
+}
+
+// Every thread replays its own random trace of small allocations against
+// the shared allocator; returns the aggregate throughput in ops/s.
+template <typename Allocator>
+static double run_threads(Allocator& a,
+                          const std::vector<std::vector<trace_op>>& traces,
+                          size_t thread_count) {
+    using clock = std::chrono::steady_clock;
+
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::jthread> threads;
+    size_t total_ops = 0;
+    for (size_t t = 0; t < thread_count; ++t) {
+        total_ops += traces[t].size();
+        threads.emplace_back([&, t] {
+            const auto& trace = traces[t];
+            std::vector<void*> slots(trace.size(), nullptr);
+            ++ready;
+            while (!go.load(std::memory_order_acquire)) {
+            }
+            for (const auto& op : trace) {
+                if (op.op == trace_op::alloc) {
+                    slots[op.slot] = a.allocate(op.size);
+                } else if (slots[op.slot]) {
+                    a.free(slots[op.slot]);
+                    slots[op.slot] = nullptr;
+                }
+            }
+        });
+    }
+    while (ready.load() != thread_count) {
+    }
+    auto start = clock::now();
+    go.store(true, std::memory_order_release);
+    threads.clear();
+    auto stop = clock::now();
+    return total_ops / std::chrono::duration<double>(stop - start).count();
+}
+
+static void run_scaling() {
+    constexpr size_t Min = 1 << 5;
+    constexpr size_t Max = 1 << 28;
+    const size_t max_threads = std::thread::hardware_concurrency();
+    std::vector<std::vector<trace_op>> traces;
+    for (size_t t = 0; t < max_threads; ++t) {
+        traces.push_back(random_trace(500'000, 256, 16, 4 << 10, 100 + t));
+    }
+
+    fmt::print("allocator,threads,ops_per_s\n");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        {
+            auto mem = std::make_unique<concurrent_buddy<Min, Max>>(Max);
+            fmt::print("concurrent_buddy,{},{:.0f}\n", threads,
+                       run_threads(*mem, traces, threads));
+        }
+        {
+            auto mem = std::make_unique<concurrent_buddy<Min, Max>>(
+                Max, /*cache_bytes_per_order=*/0);
+            fmt::print("locked_buddy,{},{:.0f}\n", threads,
+                       run_threads(*mem, traces, threads));
+        }
+        malloc_allocator m;
+        fmt::print("malloc,{},{:.0f}\n", threads,
+                   run_threads(m, traces, threads));
+    }
+}
+
+// Container workloads modelled on the users of the arena: the hash maps of
+// ts_merge_partial_results, sliding window buffers and matrix rows.
+static void pmr_hash_map(std::pmr::memory_resource* mr) {
+    std::pmr::unordered_map<std::pmr::string, int> m{mr};
+    for (int i = 0; i < 200'000; ++i) {
+        m.emplace(std::pmr::string{fmt::format("key_with_some_length_{}", i),
+                                   mr},
+                  i);
+    }
+}
+
+static void pmr_ordered_map(std::pmr::memory_resource* mr) {
+    std::pmr::map<int, int> m{mr};
+    for (int i = 0; i < 200'000; ++i) {
+        m.emplace((i * 7919) % 200'000, i);
+    }
+}
+
+static void pmr_windows(std::pmr::memory_resource* mr) {
+    for (int w = 0; w < 20'000; ++w) {
+        std::pmr::vector<int> window{mr};
+        for (int i = 0; i < 101; ++i) {
+            window.push_back(i);
+        }
+    }
+}
+
+static void pmr_matrix_rows(std::pmr::memory_resource* mr) {
+    std::pmr::vector<std::pmr::vector<double>> rows{mr};
+    for (int r = 0; r < 1024; ++r) {
+        rows.emplace_back(1024, 1.0);
+    }
+}
+
+static void run_pmr() {
+    using clock = std::chrono::steady_clock;
+    using arena = buddy<(1 << 5), (1 << 28)>;
+
+    struct workload {
+        std::string_view name;
+        void (*run)(std::pmr::memory_resource*);
+    };
+    const workload workloads[] = {
+        {"unordered_map<string>", pmr_hash_map},
+        {"map<int>", pmr_ordered_map},
+        {"window_vectors", pmr_windows},
+        {"matrix_rows", pmr_matrix_rows},
+    };
+
+    auto measure = [](auto&& f) {
+        auto start = clock::now();
+        f();
+        auto stop = clock::now();
+        return std::chrono::duration<double, std::milli>(stop - start).count();
+    };
+
+    fmt::print("workload,resource,ms,fallbacks\n");
+    for (const auto& [name, run] : workloads) {
+        auto mem = std::make_unique<arena>(1 << 28);
+        buddy_memory_resource buddy_mr{*mem, std::pmr::new_delete_resource()};
+        fmt::print("{},buddy,{:.3f},{}\n", name,
+                   measure([&] { run(&buddy_mr); }), buddy_mr.fallback_count());
+
+        double monotonic_ms = measure([&] {
+            std::pmr::monotonic_buffer_resource mono;
+            run(&mono);
+        });
+        fmt::print("{},monotonic,{:.3f},0\n", name, monotonic_ms);
+
+        fmt::print("{},default,{:.3f},0\n", name, measure([&] {
+                       run(std::pmr::get_default_resource());
+                   }));
+    }
+}
+
+struct alloc_free_result {
+    size_t succeeded = 0;
+    size_t requested_bytes = 0;  // Of the successful allocations.
+    double ns_per_op = 0;
+};
+
+// Allocates `sizes` in order, calls `on_full()` and frees everything again.
+template <typename Allocator, typename F>
+static alloc_free_result alloc_free_all(Allocator& a,
+                                        const std::vector<std::uint32_t>& sizes,
+                                        F&& on_full) {
+    using clock = std::chrono::steady_clock;
+
+    alloc_free_result res;
+    std::vector<void*> ptrs(sizes.size());
+    auto start = clock::now();
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        ptrs[i] = a.allocate(sizes[i]);
+    }
+    auto mid = clock::now();
+    on_full();
+    auto resume = clock::now();
+    for (auto* p : ptrs) {
+        if (p) {
+            a.free(p);
+        }
+    }
+    auto stop = clock::now();
+
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        if (ptrs[i]) {
+            ++res.succeeded;
+            res.requested_bytes += sizes[i];
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed =
+        (mid - start) + (stop - resume);
+    res.ns_per_op = elapsed.count() / (2 * sizes.size());
+    return res;
+}
+
+static void run_slab() {
+    constexpr size_t Min = 1 << 16;
+    constexpr size_t Max = 1 << 28;
+    using arena = buddy<Min, Max>;
+
+    std::mt19937_64 rng{7};
+    std::uniform_real_distribution<double> log_size(4, 10);  // 16 B .. 1 KiB
+    std::vector<std::uint32_t> sizes(200'000);
+    for (auto& sz : sizes) {
+        sz = static_cast<std::uint32_t>(std::exp2(log_size(rng)));
+    }
+
+    fmt::print(
+        "allocator,allocs,succeeded,requested_bytes,reserved_bytes,"
+        "utilization,ns_per_op\n");
+    auto print_row = [&](std::string_view name, const alloc_free_result& r,
+                         size_t reserved) {
+        fmt::print(
+            "{},{},{},{},{},{:.3f},{:.1f}\n", name, sizes.size(), r.succeeded,
+            r.requested_bytes, reserved,
+            reserved ? static_cast<double>(r.requested_bytes) / reserved : 0.0,
+            r.ns_per_op);
+    };
+
+    {
+        auto mem = std::make_unique<arena>(Max);
+        auto r = alloc_free_all(*mem, sizes, [] {});
+        // Every small request takes a whole Min block.
+        print_row("buddy", r, r.succeeded * Min);
+    }
+    {
+        auto mem = std::make_unique<arena>(Max);
+        slab_allocator<arena> slabs{*mem};
+        size_t reserved = 0;
+        auto r = alloc_free_all(slabs, sizes,
+                                [&] { reserved = slabs.slab_count() * Min; });
+        print_row("buddy+slab", r, reserved);
+    }
+    {
+        malloc_allocator m;
+        auto r = alloc_free_all(m, sizes, [] {});
+        print_row("malloc", r, 0);
+    }
+}
+
+static size_t resident_bytes() {
+    size_t pages = 0;
+    size_t resident = 0;
+    if (auto* f = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(f, "%zu %zu", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(f);
+    }
+    return resident * 4096;
+}
+
+static void run_rss() {
+    using clock = std::chrono::steady_clock;
+    constexpr size_t Min = 1 << 12;
+    constexpr size_t Max = size_t{1} << 30;
+    constexpr size_t Block = 1 << 20;
+    using arena = buddy<Min, Max>;
+
+    struct config {
+        std::string_view name;
+        buddy_options opts;
+    };
+    const config configs[] = {
+        {"vector", {}},
+        {"mmap", {.use_mmap = true}},
+        {"mmap+thp", {.use_mmap = true, .huge_pages = true}},
+        {"mmap_no_decommit", {.use_mmap = true, .decommit_bytes = 0}},
+    };
+
+    auto mib = [](size_t bytes) { return bytes / double(1 << 20); };
+    fmt::print(
+        "backing,startup_ms,rss_start_mib,rss_half_full_mib,rss_after_free_mib"
+        "\n");
+    for (const auto& [name, opts] : configs) {
+        const size_t rss_before = resident_bytes();
+        auto start = clock::now();
+        auto mem = std::make_unique<arena>(Max, opts);
+        auto stop = clock::now();
+        const size_t rss_start = resident_bytes() - rss_before;
+
+        // Fill half of the arena in 1 MiB blocks and touch them.
+        std::vector<void*> blocks;
+        for (size_t i = 0; i < Max / Block / 2; ++i) {
+            auto* p = static_cast<std::byte*>(mem->allocate(Block));
+            std::fill_n(p, Block, std::byte{1});
+            blocks.push_back(p);
+        }
+        const size_t rss_full = resident_bytes() - rss_before;
+        for (auto* p : blocks) {
+            mem->free(p);
+        }
+        const size_t rss_freed = resident_bytes() - rss_before;
+
+        fmt::print("{},{:.3f},{:.1f},{:.1f},{:.1f}\n", name,
+                   std::chrono::duration<double, std::milli>(stop - start)
+                       .count(),
+                   mib(rss_start), mib(rss_full), mib(rss_freed));
+    }
+}
+
+// Replays the latency traces on buddy and prints the arena's counters when
+// half of the trace has run, one JSON object per line.
+static void run_stats() {
+    constexpr size_t Min = 1 << 6;
+    constexpr size_t Max = 1 << 26;
+    using arena = buddy<Min, Max>;
+
+    const std::pair<std::string_view, std::vector<trace_op>> traces[] = {
+        {"random", random_trace(1'000'000, 4'000, 16, 64 << 10, 42)},
+        {"fragmented",
+         fragmented_trace(1'000'000, Max / Min / 2, Min, /*seed=*/43)},
+    };
+    for (const auto& [name, ops] : traces) {
+        auto mem = std::make_unique<arena>(Max);
+        std::vector<void*> slots;
+        for (size_t i = 0; i < ops.size() / 2; ++i) {
+            const auto& op = ops[i];
+            if (op.slot >= slots.size()) {
+                slots.resize(op.slot + 1);
+            }
+            if (op.op == trace_op::alloc) {
+                slots[op.slot] = mem->allocate(op.size);
+            } else if (slots[op.slot]) {
+                mem->free(slots[op.slot]);
+                slots[op.slot] = nullptr;
+            }
+        }
+        fmt::print("{{\"trace\":\"{}\",\"stats\":", name);
+        write_json(stdout, mem->stats());
+        fmt::print("}}\n");
+    }
+}
+
+struct resize_step {
+    std::uint32_t buffer;
+    std::uint32_t size;
+};
+
+// `buffers` buffers grown round-robin from `first` to `last` bytes, each step
+// multiplying the size by `factor` and adding `increment`.
+static std::vector<resize_step> growth_pattern(size_t buffers, size_t first,
+                                               size_t last, double factor,
+                                               size_t increment) {
+    std::vector<resize_step> steps;
+    for (size_t size = first; size <= last;) {
+        for (size_t b = 0; b < buffers; ++b) {
+            steps.push_back({static_cast<std::uint32_t>(b),
+                             static_cast<std::uint32_t>(size)});
+        }
+        size = static_cast<size_t>(size * factor) + increment;
+    }
+    return steps;
+}
+
+// Replays `steps`, filling the bytes each step adds, and prints how often
+// the buffer moved and how much was copied.
+template <typename Resize, typename Release>
+static void run_growth(std::string_view allocator_name,
+                       std::string_view pattern,
+                       const std::vector<resize_step>& steps, Resize resize,
+                       Release release) {
+    using clock = std::chrono::steady_clock;
+
+    size_t buffer_count = 0;
+    for (const auto& s : steps) {
+        buffer_count = std::max<size_t>(buffer_count, s.buffer + 1);
+    }
+    std::vector<std::byte*> buffers(buffer_count, nullptr);
+    std::vector<size_t> sizes(buffer_count, 0);
+    size_t moves = 0;
+    size_t copied = 0;
+    size_t failed = 0;
+
+    auto start = clock::now();
+    for (const auto& s : steps) {
+        auto*& p = buffers[s.buffer];
+        auto& size = sizes[s.buffer];
+        auto* q = static_cast<std::byte*>(resize(p, size, s.size));
+        if (!q) {
+            ++failed;
+            continue;
+        }
+        if (p && q != p) {
+            ++moves;
+            copied += size;
+        }
+        std::fill(q + size, q + s.size, std::byte{1});
+        p = q;
+        size = s.size;
+    }
+    auto stop = clock::now();
+    for (auto* p : buffers) {
+        if (p) {
+            release(p);
+        }
+    }
+
+    fmt::print("{},{},{},{},{},{:.1f},{:.3f}\n", allocator_name, pattern,
+               steps.size(), failed, moves, copied / double(1 << 20),
+               std::chrono::duration<double, std::milli>(stop - start)
+                   .count());
+}
+
+static void run_realloc() {
+    constexpr size_t Min = 1 << 6;
+    constexpr size_t Max = 1 << 28;
+    using arena = buddy<Min, Max>;
+
+    const std::pair<std::string_view, std::vector<resize_step>> patterns[] = {
+        {"doubling", growth_pattern(1, 64, 64 << 20, 2.0, 0)},
+        {"interleaved_x1.5", growth_pattern(64, 64, 1 << 20, 1.5, 0)},
+        {"append_4k", growth_pattern(16, 4096, 1 << 20, 1.0, 4096)},
+    };
+
+    fmt::print("allocator,pattern,resizes,failed,moves,copied_mib,ms\n");
+    for (const auto& [name, steps] : patterns) {
+        {
+            auto mem = std::make_unique<arena>(Max);
+            run_growth(
+                "buddy_reallocate", name, steps,
+                [&](void* p, size_t, size_t n) {
+                    return mem->reallocate(p, n);
+                },
+                [&](void* p) { mem->free(p); });
+        }
+        {
+            auto mem = std::make_unique<arena>(Max);
+            run_growth(
+                "buddy_copy", name, steps,
+                [&](void* p, size_t old_size, size_t n) -> void* {
+                    void* q = mem->allocate(n);
+                    if (q && p) {
+                        std::memcpy(q, p, old_size);
+                        mem->free(p);
+                    }
+                    return q;
+                },
+                [&](void* p) { mem->free(p); });
+        }
+        run_growth(
+            "malloc_realloc", name, steps,
+            [](void* p, size_t, size_t n) { return std::realloc(p, n); },
+            [](void* p) { std::free(p); });
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string_view> modes(argv + 1, argv + argc);
+    if (modes.empty()) {
+        modes = {"latency", "scaling", "pmr", "slab",
+                 "rss", "stats", "realloc"};
+    }
+    for (auto mode : modes) {
+        if (mode == "latency") {
+            run_latency();
+        } else if (mode == "scaling") {
+            run_scaling();
+        } else if (mode == "pmr") {
+            run_pmr();
+        } else if (mode == "slab") {
+            run_slab();
+        } else if (mode == "rss") {
+            run_rss();
+        } else if (mode == "stats") {
+            run_stats();
+        } else if (mode == "realloc") {
+            run_realloc();
+        } else {
+            fmt::print(stderr, "unknown benchmark '{}'\n", mode);
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,565 @@
+// Records, replays and fuzzes allocation traces (see allocation_trace.hpp).
+//
+//     buddy_trace_replay record <pattern> <file> [ops] [seed]
+//     buddy_trace_replay replay <pattern|file>...
+//     buddy_trace_replay timeline <pattern|file> [samples]
+//     buddy_trace_replay fuzz [pattern|file] [ops] [seeds]
+//
+// Patterns: lifo, fifo, random and skewed (random order, mostly small sizes
+// with a long tail); anything else is read as a trace file.
+//
+// replay:   ops/s and latency percentiles for buddy, malloc and the std::pmr
+//           pools, CSV.
+// timeline: live bytes, footprint and fragmentation every ops/samples
+//           operations, CSV.
+// fuzz:     replays the trace on buddy and checks the arena's invariants
+//           after every operation; exits with 1 on the first violation.
+
+#include <fmt/format.h>
+
+#include "allocation_trace.hpp"
+#include "buddy_allocator.hpp"
+#include "tsc_clock.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if __has_include(<malloc.h>)
+#include <malloc.h>
+#endif
+
+static std::optional<std::vector<trace_op>> make_trace(
+    std::string_view pattern, size_t ops, std::uint64_t seed,
+    double realloc_ratio = 0) {
+    constexpr size_t target_live = 4'000;
+    auto sizes = log_uniform_sizes(16, 64 << 10);
+    if (pattern == "lifo") {
+        return synthetic_trace(ops, target_live, free_order::lifo, sizes, seed,
+                               realloc_ratio);
+    }
+    if (pattern == "fifo") {
+        return synthetic_trace(ops, target_live, free_order::fifo, sizes, seed,
+                               realloc_ratio);
+    }
+    if (pattern == "random") {
+        return synthetic_trace(ops, target_live, free_order::random, sizes,
+                               seed, realloc_ratio);
+    }
+    if (pattern == "skewed") {
+        return synthetic_trace(ops, target_live, free_order::random,
+                               skewed_sizes(), seed, realloc_ratio);
+    }
+
+    std::string path{pattern};
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        fmt::print(stderr, "cannot open trace '{}'\n", pattern);
+        return std::nullopt;
+    }
+    auto trace = read_trace(f);
+    std::fclose(f);
+    if (!trace) {
+        fmt::print(stderr, "'{}' is not a valid trace file\n", pattern);
+    }
+    return trace;
+}
+
+// Replay targets. footprint() is the memory the allocator holds for the
+// trace: allocated blocks for buddy, the heap for malloc and what the pools
+// took from upstream; fragmentation() is buddy's external fragmentation.
+
+struct buddy_target {
+    using arena = buddy<(1 << 6), (size_t{1} << 30)>;
+
+    static constexpr std::string_view name = "buddy";
+
+    void* allocate(size_t size) { return mem->allocate(size); }
+    void free(void* p, size_t) { mem->free(p); }
+    void* reallocate(void* p, size_t, size_t size) {
+        return mem->reallocate(p, size);
+    }
+    size_t footprint() const { return mem->stats().live_bytes; }
+    std::optional<double> fragmentation() const {
+        return mem->stats().external_fragmentation();
+    }
+
+    std::unique_ptr<arena> mem = std::make_unique<arena>(
+        size_t{1} << 30, buddy_options{.use_mmap = true});
+};
+
+struct malloc_target {
+    static constexpr std::string_view name = "malloc";
+
+    void* allocate(size_t size) { return std::malloc(size); }
+    void free(void* p, size_t) { std::free(p); }
+    // Traces never resize to 0, for which realloc() would free `p`.
+    void* reallocate(void* p, size_t, size_t size) {
+        assert(size != 0);
+        return std::realloc(p, size);
+    }
+    size_t footprint() const {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+        auto info = mallinfo2();
+        return info.arena + info.hblkhd;
+#else
+        return 0;
+#endif
+    }
+    std::optional<double> fragmentation() const { return std::nullopt; }
+};
+
+// Upstream resource that keeps track of the bytes handed out.
+class counting_resource : public std::pmr::memory_resource {
+   public:
+    size_t held() const noexcept { return _held; }
+
+   protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        void* p = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        _held += bytes;
+        return p;
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        _held -= bytes;
+    }
+
+    bool do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+   private:
+    size_t _held = 0;
+};
+
+template <typename Pool>
+struct pmr_target {
+    static constexpr std::string_view name =
+        std::is_same_v<Pool, std::pmr::synchronized_pool_resource>
+            ? "pmr_synchronized_pool"
+            : "pmr_unsynchronized_pool";
+
+    void* allocate(size_t size) { return pool->allocate(size); }
+    void free(void* p, size_t size) { pool->deallocate(p, size); }
+    void* reallocate(void* p, size_t old_size, size_t size) {
+        void* q = pool->allocate(size);
+        std::memcpy(q, p, std::min(old_size, size));
+        pool->deallocate(p, old_size);
+        return q;
+    }
+    size_t footprint() const { return upstream->held(); }
+    std::optional<double> fragmentation() const { return std::nullopt; }
+
+    std::unique_ptr<counting_resource> upstream =
+        std::make_unique<counting_resource>();
+    std::unique_ptr<Pool> pool = std::make_unique<Pool>(upstream.get());
+};
+
+struct replay_sample {
+    size_t op_index;
+    size_t live_bytes;  // Requested, not rounded.
+    size_t footprint;
+    std::optional<double> fragmentation;
+};
+
+struct replay_result {
+    size_t failed = 0;
+    size_t peak_footprint = 0;
+    std::vector<mk::tsc_clock::rep> ticks;  // Per operation.
+    std::vector<replay_sample> samples;
+};
+
+// Replays `trace` on `target`, timing every operation and sampling the
+// memory use every `sample_every` operations.
+template <typename Target>
+static replay_result replay(Target& target, const std::vector<trace_op>& trace,
+                            size_t sample_every) {
+    using mk::tsc_clock;
+
+    std::vector<void*> slots(trace_slot_count(trace), nullptr);
+    std::vector<std::uint32_t> sizes(slots.size(), 0);
+    replay_result r;
+    r.ticks.reserve(trace.size());
+    r.samples.reserve(trace.size() / sample_every + 1);
+    // malloc's footprint includes everything else on the heap.
+    const size_t baseline = target.footprint();
+    size_t live = 0;
+
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const auto& op = trace[i];
+        auto& p = slots[op.slot];
+        auto& size = sizes[op.slot];
+        if (op.op == trace_op::alloc) {
+            assert(!p && "alloc into a live slot, see valid_trace()");
+            auto start = tsc_clock::ticks();
+            p = target.allocate(op.size);
+            r.ticks.push_back(tsc_clock::ticks() - start);
+            if (p) {
+                size = op.size;
+                live += size;
+            } else {
+                ++r.failed;
+            }
+        } else if (!p) {
+            // The allocation failed, nothing to free or resize.
+        } else if (op.op == trace_op::free) {
+            auto start = tsc_clock::ticks();
+            target.free(p, size);
+            r.ticks.push_back(tsc_clock::ticks() - start);
+            live -= size;
+            p = nullptr;
+        } else {
+            auto start = tsc_clock::ticks();
+            void* q = target.reallocate(p, size, op.size);
+            r.ticks.push_back(tsc_clock::ticks() - start);
+            if (q) {
+                live = live - size + op.size;
+                p = q;
+                size = op.size;
+            } else {
+                ++r.failed;
+            }
+        }
+
+        if (i % sample_every == 0 || i + 1 == trace.size()) {
+            auto footprint = std::max(target.footprint(), baseline) - baseline;
+            r.peak_footprint = std::max(r.peak_footprint, footprint);
+            r.samples.push_back({i, live, footprint, target.fragmentation()});
+        }
+    }
+    return r;
+}
+
+static double mib(size_t bytes) { return bytes / double(1 << 20); }
+
+template <typename Target>
+static void print_summary(std::string_view trace_name,
+                          const std::vector<trace_op>& trace) {
+    Target target;
+    auto r = replay(target, trace, std::max<size_t>(trace.size() / 1000, 1));
+
+    auto ns = [](mk::tsc_clock::rep t) {
+        return mk::tsc_clock::to_duration(t).count();
+    };
+    mk::tsc_clock::rep total = 0;
+    for (auto t : r.ticks) {
+        total += t;
+    }
+    std::ranges::sort(r.ticks);
+    auto at = [&](double q) {
+        return ns(r.ticks[std::min(r.ticks.size() - 1,
+                                   static_cast<size_t>(q * r.ticks.size()))]);
+    };
+    if (r.ticks.empty()) {
+        return;
+    }
+    fmt::print("{},{},{},{},{:.2f},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f},{:.1f}\n",
+               Target::name, trace_name, r.ticks.size(), r.failed,
+               r.ticks.size() / ns(total) * 1e3, ns(total) / r.ticks.size(),
+               at(0.50), at(0.99), at(0.999), ns(r.ticks.back()),
+               mib(r.peak_footprint));
+}
+
+template <typename Target>
+static void print_timeline(std::string_view trace_name,
+                           const std::vector<trace_op>& trace,
+                           size_t samples) {
+    Target target;
+    auto r = replay(target, trace, std::max<size_t>(trace.size() / samples, 1));
+    for (const auto& s : r.samples) {
+        fmt::print("{},{},{},{:.3f},{:.3f},{:.4f},", Target::name, trace_name,
+                   s.op_index, mib(s.live_bytes), mib(s.footprint),
+                   s.footprint ? double(s.live_bytes) / s.footprint : 1.0);
+        if (s.fragmentation) {
+            fmt::print("{:.4f}", *s.fragmentation);
+        }
+        fmt::print("\n");
+    }
+}
+
+using pool_target = pmr_target<std::pmr::unsynchronized_pool_resource>;
+using synchronized_pool_target =
+    pmr_target<std::pmr::synchronized_pool_resource>;
+
+// Replays the trace on a buddy arena and checks after every operation that
+// the live blocks are where the arena says they are, do not overlap, keep
+// their contents and add up with the free blocks to the arena size; that an
+// allocation only fails when no free block is large enough; and that freeing
+// everything coalesces the arena back into its initial blocks.
+template <size_t Min, size_t Max>
+static bool fuzz(const std::vector<trace_op>& trace, size_t arena_bytes) {
+    auto mem = std::make_unique<buddy<Min, Max>>(arena_bytes);
+    auto* base = mem->base_pointer();
+    const size_t usable = arena_bytes / Min * Min;
+
+    struct live_block {
+        size_t block_size;
+        std::uint32_t size;
+        std::byte tag;
+    };
+    std::map<size_t, live_block> blocks;  // By offset.
+    std::vector<void*> slots(trace_slot_count(trace), nullptr);
+    size_t block_bytes = 0;
+    size_t i = 0;
+
+    auto fail = [&](std::string_view what) {
+        fmt::print(stderr, "fuzz: operation {} of {}: {}\n", i, trace.size(),
+                   what);
+        return false;
+    };
+    auto block_size_of = [](size_t size) {
+        return std::max(Min, std::bit_ceil(size));
+    };
+    // Tags the first and the last byte of the requested size.
+    auto tag = [](std::byte* p, size_t size, std::byte t) {
+        if (size) {
+            p[0] = t;
+            p[size - 1] = t;
+        }
+    };
+    auto tagged = [](const std::byte* p, size_t size, std::byte t) {
+        return size == 0 || (p[0] == t && p[size - 1] == t);
+    };
+    // Checks a block the arena just handed out and records it.
+    auto add = [&](void* ptr, std::uint32_t size, std::byte t) {
+        auto offset = static_cast<size_t>(static_cast<std::byte*>(ptr) - base);
+        const size_t bs = block_size_of(size);
+        if (offset % bs != 0 || offset + bs > usable) {
+            return fail("block misaligned or outside the arena");
+        }
+        if (mem->allocated_order(ptr) != order_of(bs)) {
+            return fail("arena reports a different block order");
+        }
+        auto next = blocks.lower_bound(offset);
+        if (next != blocks.end() && offset + bs > next->first) {
+            return fail("block overlaps the next live block");
+        }
+        if (next != blocks.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second.block_size > offset) {
+                return fail("block overlaps the previous live block");
+            }
+        }
+        blocks.emplace(offset, live_block{bs, size, t});
+        block_bytes += bs;
+        return true;
+    };
+    auto remove = [&](void* ptr) {
+        auto it = blocks.find(
+            static_cast<size_t>(static_cast<std::byte*>(ptr) - base));
+        auto b = it->second;
+        block_bytes -= b.block_size;
+        blocks.erase(it);
+        return b;
+    };
+    auto check_stats = [&] {
+        auto s = mem->stats();
+        if (s.live_bytes != block_bytes) {
+            return fail("live bytes do not match the live blocks");
+        }
+        if (s.live_bytes + s.free_bytes != usable) {
+            return fail("live and free bytes do not add up to the arena");
+        }
+        size_t live_blocks = 0;
+        size_t live = 0;
+        size_t free = 0;
+        for (size_t o = 0; o < s.live_blocks.size(); ++o) {
+            live_blocks += s.live_blocks[o];
+            live += s.live_blocks[o] << (s.min_order + o);
+            free += s.free_blocks[o] << (s.min_order + o);
+        }
+        if (live_blocks != blocks.size() || live != s.live_bytes ||
+            free != s.free_bytes) {
+            return fail("per-order counts do not match the totals");
+        }
+        return true;
+    };
+
+    for (; i < trace.size(); ++i) {
+        const auto& op = trace[i];
+        auto& p = slots[op.slot];
+        const auto t = static_cast<std::byte>(op.slot * 131 + 7);
+        const size_t largest_free = mem->stats().largest_free_block;
+
+        if (op.op == trace_op::alloc) {
+            assert(!p && "alloc into a live slot, see valid_trace()");
+            p = mem->allocate(op.size);
+            if (!p) {
+                if (op.size <= Max && largest_free >= block_size_of(op.size)) {
+                    return fail("allocation failed with a large enough block "
+                                "free");
+                }
+                continue;
+            }
+            tag(static_cast<std::byte*>(p), op.size, t);
+            if (!add(p, op.size, t)) {
+                return false;
+            }
+        } else if (!p) {
+            continue;
+        } else if (op.op == trace_op::free) {
+            auto b = remove(p);
+            if (!tagged(static_cast<std::byte*>(p), b.size, b.tag)) {
+                return fail("block contents changed while allocated");
+            }
+            mem->free(p);
+            p = nullptr;
+        } else {
+            auto b = blocks.at(
+                static_cast<size_t>(static_cast<std::byte*>(p) - base));
+            void* q = mem->reallocate(p, op.size);
+            if (!q) {
+                if (op.size <= Max && largest_free >= block_size_of(op.size)) {
+                    return fail("reallocation failed with a large enough "
+                                "block free");
+                }
+                continue;
+            }
+            remove(p);
+            const size_t kept = std::min<size_t>(b.size, op.size);
+            auto* bytes = static_cast<std::byte*>(q);
+            if (kept && (bytes[0] != b.tag ||
+                         (kept == b.size && bytes[kept - 1] != b.tag))) {
+                return fail("reallocation lost the block contents");
+            }
+            tag(bytes, op.size, t);
+            if (!add(q, op.size, t)) {
+                return false;
+            }
+            p = q;
+        }
+        if (!check_stats()) {
+            return false;
+        }
+    }
+
+    for (auto* p : slots) {
+        if (p) {
+            mem->free(p);
+            remove(p);
+        }
+    }
+    auto s = mem->stats();
+    for (size_t o = 0; o < s.free_blocks.size(); ++o) {
+        if (s.free_blocks[o] != ((usable >> (s.min_order + o)) & 1)) {
+            return fail("arena did not coalesce back to its initial blocks");
+        }
+    }
+    return check_stats();
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string_view> args(argv + 1, argv + argc);
+    auto arg = [&](size_t i, size_t fallback) -> size_t {
+        return i < args.size() ? std::stoull(std::string{args[i]}) : fallback;
+    };
+    const std::string_view mode = args.empty() ? "replay" : args[0];
+
+    if (mode == "record" && args.size() >= 3) {
+        auto trace = make_trace(args[1], arg(3, 1'000'000), arg(4, 42));
+        std::string path{args[2]};
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        if (!trace || !f || !write_trace(f, *trace)) {
+            fmt::print(stderr, "cannot write '{}'\n", path);
+            return 1;
+        }
+        std::fclose(f);
+        return 0;
+    }
+
+    if (mode == "replay") {
+        std::vector<std::string_view> names(args.begin() + !args.empty(),
+                                            args.end());
+        if (names.empty()) {
+            names = {"lifo", "fifo", "random", "skewed"};
+        }
+        fmt::print(
+            "allocator,trace,ops,failed,mops_per_s,mean_ns,p50_ns,p99_ns,"
+            "p999_ns,max_ns,peak_footprint_mib\n");
+        for (auto name : names) {
+            auto trace = make_trace(name, 1'000'000, 42);
+            if (!trace) {
+                return 1;
+            }
+            print_summary<buddy_target>(name, *trace);
+            print_summary<malloc_target>(name, *trace);
+            print_summary<pool_target>(name, *trace);
+            print_summary<synchronized_pool_target>(name, *trace);
+        }
+        return 0;
+    }
+
+    if (mode == "timeline" && args.size() >= 2) {
+        auto trace = make_trace(args[1], 1'000'000, 42);
+        if (!trace) {
+            return 1;
+        }
+        const size_t samples = arg(2, 100);
+        fmt::print(
+            "allocator,trace,op,live_mib,footprint_mib,utilization,"
+            "external_fragmentation\n");
+        print_timeline<buddy_target>(args[1], *trace, samples);
+        print_timeline<malloc_target>(args[1], *trace, samples);
+        print_timeline<pool_target>(args[1], *trace, samples);
+        print_timeline<synchronized_pool_target>(args[1], *trace, samples);
+        return 0;
+    }
+
+    if (mode == "fuzz") {
+        std::vector<std::string_view> names{"lifo", "fifo", "random",
+                                            "skewed"};
+        if (args.size() >= 2) {
+            names = {args[1]};
+        }
+        const size_t ops = arg(2, 200'000);
+        const size_t seeds = arg(3, 4);
+        constexpr size_t Min = 1 << 6;
+        constexpr size_t Max = 1 << 24;
+        for (auto name : names) {
+            for (size_t seed = 1; seed <= seeds; ++seed) {
+                // A tenth of the operations resize a live block.
+                auto trace = make_trace(name, ops, seed, 0.1);
+                if (!trace) {
+                    return 1;
+                }
+                // Also an arena that is not a power of two and ends in the
+                // middle of a Min block.
+                for (size_t size : {Max, Max - 5 * 4096 - 3 * Min - 17}) {
+                    if (!fuzz<Min, Max>(*trace, size)) {
+                        fmt::print(stderr,
+                                   "fuzz: trace {}, seed {}, arena {}\n", name,
+                                   seed, size);
+                        return 1;
+                    }
+                }
+                fmt::print("{} seed {}: ok\n", name, seed);
+            }
+        }
+        return 0;
+    }
+
+    fmt::print(stderr,
+               "usage: buddy_trace_replay record <pattern> <file> [ops] "
+               "[seed]\n"
+               "       buddy_trace_replay replay <pattern|file>...\n"
+               "       buddy_trace_replay timeline <pattern|file> [samples]\n"
+               "       buddy_trace_replay fuzz [pattern|file] [ops] [seeds]\n");
+    return 1;
+}
@@ -0,0 +1,123 @@
+// Benchmarks for solving many small N x N systems (N = 3, 4, 6, 8) with
+// random, diagonally dominant double matrices. Prints CSV.
+//
+//     fixed_matrix_bench [systems]
+//
+// jagged:  gaussian_elimination on [A | b] as matrix<double>, then back
+//          substitution, one system at a time.
+// fixed:   solve() on fixed_matrix, one system at a time.
+// batched: solve_batch(), soa_batch<double, N>::lanes systems at a time,
+//          once per instruction set the CPU supports.
+//
+// max_abs_diff is the largest difference to the fixed results.
+
+#include <fmt/format.h>
+
+#include "fixed_matrix.hpp"
+#include "gaussian_elimination.hpp"
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// The fixed solver is a constant expression.
+static_assert(*solve(fixed_matrix<double, 2, 2>{{{{2, 1}, {1, 3}}}},
+                     std::array<double, 2>{3, 5}) ==
+              std::array<double, 2>{0.8, 1.4});
+
+template <typename F>
+static double time_ms(F&& f) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    f();
+    auto stop = clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+template <size_t N>
+static void run(size_t systems) {
+    std::mt19937_64 rng{N};
+    std::uniform_real_distribution<double> d(-1, 1);
+    std::vector<fixed_matrix<double, N, N>> A(systems);
+    std::vector<std::array<double, N>> b(systems);
+    for (size_t m = 0; m < systems; ++m) {
+        for (size_t i = 0; i < N; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                A[m][i][j] = d(rng);
+            }
+            A[m][i][i] += N;
+            b[m][i] = d(rng);
+        }
+    }
+
+    auto max_abs_diff = [&](const std::vector<std::array<double, N>>& x,
+                            const std::vector<std::array<double, N>>& y) {
+        double diff = 0;
+        for (size_t m = 0; m < systems; ++m) {
+            for (size_t i = 0; i < N; ++i) {
+                diff = std::max(diff, std::abs(x[m][i] - y[m][i]));
+            }
+        }
+        return diff;
+    };
+    auto print_row = [&](std::string_view impl, std::string_view isa,
+                         double ms, double diff) {
+        fmt::print("{},{},{},{},{:.1f},{:.1f},{:.3g}\n", impl, isa, N,
+                   systems, ms, ms * 1e6 / systems, diff);
+    };
+
+    std::vector<std::array<double, N>> fixed(systems);
+    const double fixed_ms = time_ms([&] {
+        for (size_t m = 0; m < systems; ++m) {
+            fixed[m] = *solve(A[m], b[m]);
+        }
+    });
+
+    std::vector<std::array<double, N>> jagged(systems);
+    const double jagged_ms = time_ms([&] {
+        for (size_t m = 0; m < systems; ++m) {
+            matrix<double> aug(N, std::vector<double>(N + 1));
+            for (size_t i = 0; i < N; ++i) {
+                std::ranges::copy(A[m][i], aug[i].begin());
+                aug[i][N] = b[m][i];
+            }
+            gaussian_elimination(aug);
+            for (size_t i = N; i-- > 0;) {
+                double x = aug[i][N];
+                for (size_t j = i + 1; j < N; ++j) {
+                    x -= aug[i][j] * jagged[m][j];
+                }
+                jagged[m][i] = x / aug[i][i];
+            }
+        }
+    });
+    print_row("jagged", "scalar", jagged_ms, max_abs_diff(jagged, fixed));
+    print_row("fixed", "scalar", fixed_ms, 0);
+
+    for (auto isa : {simd::isa::portable, simd::isa::avx2, simd::isa::avx512}) {
+        if (isa > simd::detected_isa()) continue;
+        simd::select_isa(isa);
+        std::vector<std::array<double, N>> batched(systems);
+        const double ms = time_ms([&] {
+            solve_batch<double, N>(A, b, batched);
+        });
+        print_row("batched", simd::to_string(isa), ms,
+                  max_abs_diff(batched, fixed));
+    }
+}
+
+int main(int argc, char** argv) {
+    const size_t systems = argc > 1 ? std::stoull(argv[1]) : 1'000'000;
+    fmt::print("impl,isa,n,systems,ms,ns_per_system,max_abs_diff\n");
+    run<3>(systems);
+    run<4>(systems);
+    run<6>(systems);
+    run<8>(systems);
+}
@@ -0,0 +1,265 @@
+// Benchmarks for gaussian_elimination on random n x n double matrices.
+// Prints CSV.
+//
+//     gaussian_elimination_bench [n]...
+//     gaussian_elimination_bench scaling [n]...
+//     gaussian_elimination_bench solve [n] [rhs]
+//
+// jagged:  the original elimination on vector<vector<double>>.
+// dense:   the same algorithm on a contiguous dense_matrix.
+// blocked: blocked_gaussian_elimination on a dense_matrix, once per
+//          instruction set the row update kernels can use on this CPU.
+//
+// max_abs_diff is the largest elementwise difference to the jagged result.
+//
+// scaling: strong scaling of parallel_gaussian_elimination from one thread
+//          to one per hardware thread, doubling, on the same matrix. Speedup
+//          and efficiency are relative to the one thread run, max_abs_diff
+//          to blocked_gaussian_elimination.
+//
+// solve:   `rhs` systems with the same n x n matrix. eliminate runs
+//          blocked_gaussian_elimination on [A | b] and back-substitutes for
+//          each right-hand side, timed on the first few and reported per
+//          right-hand side; lu factors once and solves all of them as one
+//          block. max_residual is the largest |AX - B|.
+
+#include <fmt/format.h>
+
+#include "dense_matrix.hpp"
+#include "gaussian_elimination.hpp"
+#include "lu_factorization.hpp"
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+static dense_matrix<double> random_matrix(size_t n, std::uint64_t seed,
+                                          size_t cols = 0) {
+    std::mt19937_64 rng{seed};
+    std::uniform_real_distribution<double> d(-1, 1);
+    dense_matrix<double> m(n, cols ? cols : n);
+    for (size_t i = 0; i < n; ++i) {
+        std::ranges::generate(m.view().row(i), [&] { return d(rng); });
+    }
+    return m;
+}
+
+static matrix<double> to_jagged(matrix_view<const double> m) {
+    matrix<double> out(m.rows());
+    for (size_t i = 0; i < m.rows(); ++i) {
+        out[i].assign(m.row(i).begin(), m.row(i).end());
+    }
+    return out;
+}
+
+static double max_abs_diff(const matrix<double>& a,
+                           matrix_view<const double> b) {
+    double diff = 0;
+    for (size_t i = 0; i < b.rows(); ++i) {
+        for (size_t j = 0; j < b.cols(); ++j) {
+            diff = std::max(diff, std::abs(a[i][j] - b[i][j]));
+        }
+    }
+    return diff;
+}
+
+static double max_abs_diff(matrix_view<const double> a,
+                           matrix_view<const double> b) {
+    double diff = 0;
+    for (size_t i = 0; i < b.rows(); ++i) {
+        for (size_t j = 0; j < b.cols(); ++j) {
+            diff = std::max(diff, std::abs(a[i][j] - b[i][j]));
+        }
+    }
+    return diff;
+}
+
+template <typename F>
+static double time_ms(F&& f) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    f();
+    auto stop = clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+static void run_scaling(const std::vector<size_t>& sizes) {
+    const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> thread_counts;
+    for (size_t t = 1; t < hw; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(hw);
+
+    fmt::print("impl,isa,n,threads,ms,gflops,speedup,efficiency,"
+               "max_abs_diff\n");
+    for (auto n : sizes) {
+        const auto input = random_matrix(n, n);
+        const double flops = 2.0 / 3.0 * n * n * n;
+        auto reference = input;
+        blocked_gaussian_elimination(reference.view());
+
+        double base_ms = 0;
+        for (auto threads : thread_counts) {
+            auto A = input;
+            const double ms = time_ms(
+                [&] { parallel_gaussian_elimination(A.view(), threads); });
+            if (threads == 1) {
+                base_ms = ms;
+            }
+            const double speedup = base_ms / ms;
+            fmt::print("parallel,{},{},{},{:.1f},{:.2f},{:.2f},{:.2f},{:.3g}\n",
+                       simd::to_string(simd::active_isa()), n, threads, ms,
+                       flops / ms / 1e6, speedup, speedup / threads,
+                       max_abs_diff(reference, A));
+        }
+    }
+}
+
+// max |AX - B| over all entries.
+static double max_residual(matrix_view<const double> A,
+                           matrix_view<const double> X,
+                           matrix_view<const double> B) {
+    double residual = 0;
+    std::vector<double> ax(B.cols());
+    for (size_t i = 0; i < A.rows(); ++i) {
+        std::ranges::fill(ax, 0.0);
+        for (size_t j = 0; j < A.cols(); ++j) {
+            for (size_t c = 0; c < B.cols(); ++c) {
+                ax[c] += A[i][j] * X[j][c];
+            }
+        }
+        for (size_t c = 0; c < B.cols(); ++c) {
+            residual = std::max(residual, std::abs(ax[c] - B[i][c]));
+        }
+    }
+    return residual;
+}
+
+// Solves Ax = B[., c] from scratch: eliminates [A | b], then substitutes
+// back through the row echelon form.
+static void eliminate_and_solve(matrix_view<const double> A,
+                                matrix_view<const double> B, size_t c,
+                                matrix_view<double> X) {
+    const size_t n = A.rows();
+    dense_matrix<double> aug(n, n + 1);
+    for (size_t i = 0; i < n; ++i) {
+        std::ranges::copy(A.row(i), aug[i]);
+        aug[i][n] = B[i][c];
+    }
+    blocked_gaussian_elimination(aug.view());
+    for (size_t i = n; i-- > 0;) {
+        double x = aug[i][n];
+        for (size_t j = i + 1; j < n; ++j) {
+            x -= aug[i][j] * X[j][c];
+        }
+        X[i][c] = x / aug[i][i];
+    }
+}
+
+static void run_solve(size_t n, size_t rhs) {
+    const auto A = random_matrix(n, 1);
+    const auto B = random_matrix(n, 2, rhs);
+
+    fmt::print("impl,n,rhs,ms,ms_per_rhs,max_residual\n");
+    const size_t timed = std::min<size_t>(rhs, 4);
+    dense_matrix<double> X(n, timed);
+    const double eliminate_ms = time_ms([&] {
+        for (size_t c = 0; c < timed; ++c) {
+            eliminate_and_solve(A, B, c, X);
+        }
+    });
+    fmt::print("eliminate,{},{},{:.1f},{:.3f},{:.3g}\n", n, rhs,
+               eliminate_ms / timed * rhs, eliminate_ms / timed,
+               max_residual(A, X, B.view().block(0, 0, n, timed)));
+
+    lu_factorization<double> lu;
+    const double factor_ms = time_ms([&] { lu = lu_factorization(A.view()); });
+    dense_matrix<double> Y;
+    const double solve_ms = time_ms([&] { Y = lu.solve(B.view()); });
+    fmt::print("lu,{},{},{:.1f},{:.3f},{:.3g}\n", n, rhs,
+               factor_ms + solve_ms, (factor_ms + solve_ms) / rhs,
+               max_residual(A, Y, B));
+    fmt::print("lu_solve_only,{},{},{:.1f},{:.3f},\n", n, rhs, solve_ms,
+               solve_ms / rhs);
+}
+
+int main(int argc, char** argv) {
+    std::string_view mode = "compare";
+    int first = 1;
+    if (argc > 1 && !std::isdigit(static_cast<unsigned char>(argv[1][0]))) {
+        mode = argv[1];
+        ++first;
+    }
+    std::vector<size_t> sizes;
+    for (int i = first; i < argc; ++i) {
+        sizes.push_back(std::stoull(argv[i]));
+    }
+    if (mode == "scaling") {
+        if (sizes.empty()) {
+            sizes = {2048, 4096};
+        }
+        run_scaling(sizes);
+        return 0;
+    }
+    if (mode == "solve") {
+        run_solve(sizes.size() > 0 ? sizes[0] : 1024,
+                  sizes.size() > 1 ? sizes[1] : 1000);
+        return 0;
+    }
+    if (mode != "compare") {
+        fmt::print(stderr, "usage: {} [scaling|solve] [n]...\n", argv[0]);
+        return 1;
+    }
+    if (sizes.empty()) {
+        sizes = {256, 512, 1024, 2048, 4096};
+    }
+
+    std::vector<simd::isa> isas = {simd::isa::portable};
+    if (simd::detected_isa() >= simd::isa::avx2) {
+        isas.push_back(simd::isa::avx2);
+    }
+    if (simd::detected_isa() >= simd::isa::avx512) {
+        isas.push_back(simd::isa::avx512);
+    }
+
+    fmt::print("impl,isa,n,ms,gflops,max_abs_diff\n");
+    for (auto n : sizes) {
+        const auto input = random_matrix(n, n);
+        const double flops = 2.0 / 3.0 * n * n * n;
+        auto print_row = [&](std::string_view impl, std::string_view isa,
+                             double ms, double diff) {
+            fmt::print("{},{},{},{:.1f},{:.2f},{:.3g}\n", impl, isa, n, ms,
+                       flops / ms / 1e6, diff);
+        };
+
+        simd::select_isa(simd::detected_isa());
+        auto jagged = to_jagged(input);
+        const double jagged_ms =
+            time_ms([&] { gaussian_elimination(jagged); });
+        print_row("jagged", "scalar", jagged_ms, 0);
+
+        auto dense = input;
+        const double dense_ms =
+            time_ms([&] { gaussian_elimination(dense.view()); });
+        print_row("dense", simd::to_string(simd::active_isa()), dense_ms,
+                  max_abs_diff(jagged, dense));
+
+        for (auto isa : isas) {
+            simd::select_isa(isa);
+            auto blocked = input;
+            const double blocked_ms = time_ms(
+                [&] { blocked_gaussian_elimination(blocked.view()); });
+            print_row("blocked", simd::to_string(isa), blocked_ms,
+                      max_abs_diff(jagged, blocked));
+        }
+    }
+}
@@ -0,0 +1,173 @@
+// Benchmarks for elimination over GF(2) on random n x n matrices. Prints CSV.
+//
+//     gf2_elimination_bench [n]...
+//
+// int32:         Gauss-Jordan on one int32 per entry, the way
+//                gaussian_elimination stores matrix<int>, up to n = 2048.
+// plain:         gf2_elimination, one row XOR per pivot and row.
+// four_russians: gf2_elimination with the Method of Four Russians.
+//
+// The bit-packed rows run once per instruction set the XOR kernels can use
+// on this CPU. bytes is the matrix storage; every row reports the rank as a
+// cross-check. mismatches counts the rows and pivot columns of the echelon
+// form that differ from the first plain run's (the reduced row echelon form
+// is unique), plus the vectors x of gf2_nullspace() with the same method for
+// which Ax != 0.
+
+#include <fmt/format.h>
+
+#include "dense_matrix.hpp"
+#include "gf2_matrix.hpp"
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+template <typename F>
+static double time_ms(F&& f) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    f();
+    auto stop = clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+// A random matrix of rank about n - n / 16: the last rows are sums of
+// earlier ones.
+static gf2_matrix random_matrix(size_t n, std::uint64_t seed) {
+    std::mt19937_64 rng{seed};
+    gf2_matrix A(n, n);
+    const size_t independent = n - n / 16;
+    for (size_t i = 0; i < n; ++i) {
+        if (i < independent) {
+            std::generate_n(A.row(i), A.words(), std::ref(rng));
+            if (n % 64) {
+                A.row(i)[A.words() - 1] &= (std::uint64_t{1} << n % 64) - 1;
+            }
+        } else {
+            A.add_row(i, rng() % independent);
+            A.add_row(i, rng() % independent);
+        }
+    }
+    return A;
+}
+
+static size_t echelon_mismatches(const gf2_matrix& ref,
+                                 const gf2_echelon& ref_e, const gf2_matrix& A,
+                                 const gf2_echelon& e) {
+    size_t bad = 0;
+    for (size_t i = 0; i < A.rows(); ++i) {
+        bad += !std::equal(A.row(i), A.row(i) + A.words(), ref.row(i));
+    }
+    const size_t rank = std::min(e.rank, ref_e.rank);
+    bad += std::max(e.rank, ref_e.rank) - rank;
+    for (size_t t = 0; t < rank; ++t) {
+        bad += e.pivot_cols[t] != ref_e.pivot_cols[t];
+    }
+    return bad;
+}
+
+static size_t nullspace_errors(const gf2_matrix& input, size_t rank,
+                               gf2_method method) {
+    const auto basis = gf2_nullspace(input, method);
+    size_t bad = basis.rows() != input.cols() - rank;
+    for (size_t b = 0; b < basis.rows(); ++b) {
+        const auto y = input.multiply(basis.row(b));
+        bad += basis.weight(b) == 0 || std::ranges::find(y, true) != y.end();
+    }
+    return bad;
+}
+
+static size_t int32_rank(dense_matrix<std::int32_t>& A) {
+    size_t h = 0;
+    for (size_t k = 0; h < A.rows() && k < A.cols(); ++k) {
+        size_t i_pivot = h;
+        while (i_pivot < A.rows() && A[i_pivot][k] == 0) {
+            ++i_pivot;
+        }
+        if (i_pivot == A.rows()) {
+            continue;
+        }
+        A.view().swap_rows(h, i_pivot);
+        for (size_t i = 0; i < A.rows(); ++i) {
+            if (i != h && A[i][k]) {
+                for (size_t j = k; j < A.cols(); ++j) {
+                    A[i][j] ^= A[h][j];
+                }
+            }
+        }
+        ++h;
+    }
+    return h;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        sizes.push_back(std::stoull(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes = {512, 1024, 2048, 4096, 8192};
+    }
+
+    std::vector<simd::isa> isas = {simd::isa::portable};
+    if (simd::detected_isa() >= simd::isa::avx2) {
+        isas.push_back(simd::isa::avx2);
+    }
+    if (simd::detected_isa() >= simd::isa::avx512) {
+        isas.push_back(simd::isa::avx512);
+    }
+
+    fmt::print("impl,isa,n,ms,rank,bytes,mismatches\n");
+    for (auto n : sizes) {
+        const auto input = random_matrix(n, n);
+        auto print_row = [&](std::string_view impl, std::string_view isa,
+                             double ms, size_t rank, size_t bytes,
+                             size_t bad) {
+            fmt::print("{},{},{},{:.1f},{},{},{}\n", impl, isa, n, ms, rank,
+                       bytes, bad);
+        };
+
+        if (n <= 2048) {
+            dense_matrix<std::int32_t> A(n, n);
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = 0; j < n; ++j) {
+                    A[i][j] = input.get(i, j);
+                }
+            }
+            size_t rank = 0;
+            const double ms = time_ms([&] { rank = int32_rank(A); });
+            print_row("int32", "scalar", ms, rank,
+                      A.rows() * A.stride() * sizeof(std::int32_t), 0);
+        }
+
+        const size_t bytes = n * input.words() * sizeof(std::uint64_t);
+        std::optional<gf2_matrix> ref;
+        gf2_echelon ref_e;
+        for (auto method : {gf2_method::plain, gf2_method::four_russians}) {
+            for (auto isa : isas) {
+                simd::select_isa(isa);
+                auto A = input;
+                gf2_echelon e;
+                const double ms =
+                    time_ms([&] { e = gf2_elimination(A, method); });
+                if (!ref) {
+                    ref = A;
+                    ref_e = e;
+                }
+                const size_t bad = echelon_mismatches(*ref, ref_e, A, e) +
+                                   nullspace_errors(input, e.rank, method);
+                print_row(method == gf2_method::plain ? "plain"
+                                                      : "four_russians",
+                          simd::to_string(isa), ms, e.rank, bytes, bad);
+            }
+        }
+    }
+}
@@ -1,52 +1,52 @@
-#include <limits>
-#include <vector>
-
-using distance_t = std::size_t;
-using distance_vector = std::vector<distance_t>;
-
-template <typename T>
-T infinity() {
-    return std::numeric_limits<T>::max();
-}
-
-using vid_t = size_t;
-static constexpr vid_t null_vid = infinity<vid_t>();
-using vid_vector = std::vector<vid_t>;
+#include <fmt/format.h>
 
-template <typename Graph, typename WeightFunc>
-distance_vector bellman_ford(Graph g, WeightFunc w, vid_t seed) {
-    const auto& V = vertices(g);
+#include "csr_graph.hpp"
+#include "shortest_paths.hpp"
 
-    // init
-    distance_vector d(size(V), infinity<distance_t>());
-    vid_vector predecessor(size(V), null_vid);
+#include <cstdint>
+#include <vector>
 
-    d[seed] = 0;
-    // dla i od 1 do |V[G]| - 1 wykonaj
-    for (const auto& _ : V) {
-        //   dla każdej krawędzi (u,v) w E[G] wykonaj
-        bool modified = false;
-        for (const auto& e : edges(g)) {
-            //     jeżeli d[v] > d[u] + w(u,v) to
-            auto new_weight = d[source(e)] + w(e);
-            if (new_weight < d[target(e)]) {
-                //       d[v] = d[u] + w(u,v)
-                d[target(e)] = new_weight;
-                //       poprzednik[v] = u
-                predecessor[target(e)] = source(e);
+using graph = csr_graph<std::int32_t>;
+using edge_reference_t = graph::edge_reference;
 
-                modified = true;
-            }
+int main() {
+    const std::vector<graph::edge> E = {
+        {0, 1, 6}, {0, 3, 7},  {1, 2, 5},  {1, 3, 8}, {1, 4, -4},
+        {2, 1, -2}, {3, 2, -3}, {3, 4, 9}, {4, 0, 2}, {4, 2, 7},
+    };
+    const graph g(6, E);  // vertex 5 is unreachable
+    auto w = [&g](edge_reference_t e) { return g.weight(e); };
+    auto [d, predecessor] = bellman_ford(g, w, 0);
+
+    for (auto v : vertices(g)) {
+        if (d[v] == infinity<distance_t>()) {
+            fmt::print("{}: unreachable\n", v);
+            continue;
+        }
+        fmt::print("{}: distance {:3}, path", v, d[v]);
+        std::vector<vid_t> path;
+        for (vid_t u = v; u != null_vid; u = predecessor[u]) {
+            path.push_back(u);
         }
-        if (!modified) {
-            // Optimization: don't repeat if no edge was relaxed in this
-            // iteration.
-            break;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            fmt::print(" {}", *it);
         }
+        fmt::print("\n");
     }
-}
 
-int main() {
-    graph g;
-    bellman_ford(g, [](edge_reference_t e) { return 1; });
+    const auto parallel = parallel_bellman_ford(g, w, 0);
+    fmt::print("parallel_bellman_ford {}\n",
+               parallel.distance == d ? "agrees" : "differs");
+
+    // 4 -> 3 closes negative cycles, such as 3 -> 4 -> 3 at 9 - 10.
+    auto E2 = E;
+    E2.push_back({4, 3, -10});
+    const graph g2(6, E2);
+    const auto [paths, cycle] = spfa(
+        g2, [&g2](edge_reference_t e) { return g2.weight(e); }, 0);
+    fmt::print("negative cycle:");
+    for (auto v : cycle) {
+        fmt::print(" {}", v);
+    }
+    fmt::print("\n");
 }
@@ -0,0 +1,259 @@
+// Benchmarks for single-source shortest paths on random graphs with weights
+// in [1, 1000]. Prints CSV.
+//
+//     shortest_paths_bench [n] [degree]
+//     shortest_paths_bench multi [n] [degree] [sources]
+//
+// Two graphs with n vertices: "random", every vertex with `degree` edges to
+// uniformly random targets (small diameter), and "grid", a square grid with
+// edges both ways between neighbours plus degree - 4 random edges to
+// vertices at most 8 rows away (large diameter, like road networks).
+//
+// bellman_ford:          the full sweep over the edge array per pass.
+// spfa:                  the queue of changed vertices, with the SLF and LLL
+//                        heuristics.
+// parallel_bellman_ford: frontier rounds, for 1, 2, 4, ... threads up to
+//                        the hardware threads.
+// delta_stepping:        for several delta on all hardware threads.
+//
+// rounds is bellman_ford's number of passes and scanned the edges the
+// sequential engines relax, counted on a second run; mismatches counts
+// distances that differ from bellman_ford's, and predecessors that do not
+// lie on a shortest path.
+//
+// multi: shortest paths from `sources` random seeds. bellman_ford and spfa
+//        run once per seed; multi_source_bellman_ford takes them
+//        multi_source_paths::lanes at a time, once per instruction set the
+//        CPU supports. mismatches are summed over the seeds.
+
+#include <fmt/format.h>
+
+#include "csr_graph.hpp"
+#include "multi_source_paths.hpp"
+#include "shortest_paths.hpp"
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using graph = csr_graph<std::int32_t>;
+
+template <typename F>
+static double time_ms(F&& f) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    f();
+    auto stop = clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+static graph random_graph(size_t n, size_t degree, std::uint64_t seed) {
+    std::mt19937_64 rng{seed};
+    std::uniform_int_distribution<vid_t> vertex(0, vid_t(n - 1));
+    std::uniform_int_distribution<std::int32_t> weight(1, 1000);
+    std::vector<graph::edge> E;
+    E.reserve(n * degree);
+    for (size_t u = 0; u < n; ++u) {
+        for (size_t k = 0; k < degree; ++k) {
+            E.push_back({vid_t(u), vertex(rng), weight(rng)});
+        }
+    }
+    return {n, E};
+}
+
+static graph grid_graph(size_t n, size_t degree, std::uint64_t seed) {
+    std::mt19937_64 rng{seed};
+    std::uniform_int_distribution<std::int32_t> weight(1, 1000);
+    const size_t side = std::max<size_t>(1, std::sqrt(double(n)));
+    n = side * side;
+    const auto reach = 8 * std::ptrdiff_t(side);
+    std::uniform_int_distribution<std::ptrdiff_t> near(-reach, reach);
+    std::vector<graph::edge> E;
+    E.reserve(n * degree);
+    for (size_t y = 0; y < side; ++y) {
+        for (size_t x = 0; x < side; ++x) {
+            const auto u = vid_t(y * side + x);
+            if (x > 0) E.push_back({u, u - 1, weight(rng)});
+            if (x + 1 < side) E.push_back({u, u + 1, weight(rng)});
+            if (y > 0) E.push_back({u, vid_t(u - side), weight(rng)});
+            if (y + 1 < side) E.push_back({u, vid_t(u + side), weight(rng)});
+            for (size_t k = 4; k < degree; ++k) {
+                const auto v = std::clamp<std::ptrdiff_t>(u + near(rng), 0,
+                                                          n - 1);
+                E.push_back({u, vid_t(v), weight(rng)});
+            }
+        }
+    }
+    return {n, E};
+}
+
+// Distances that differ from the reference, plus predecessors that are not
+// the source of a tight edge into their vertex.
+static size_t mismatches(const graph& g, const shortest_paths& ref,
+                         const shortest_paths& p) {
+    size_t bad = 0;
+    for (auto v : vertices(g)) {
+        bad += p.distance[v] != ref.distance[v];
+    }
+    std::vector<bool> tight(g.vertex_count());
+    for (const auto& e : edges(g)) {
+        const auto u = source(e);
+        const auto v = target(e);
+        if (p.predecessor[v] == u && p.distance[u] != infinity<distance_t>() &&
+            p.distance[u] + g.weight(e) == p.distance[v]) {
+            tight[v] = true;
+        }
+    }
+    for (auto v : vertices(g)) {
+        bad += (p.predecessor[v] != null_vid) != bool(tight[v]);
+    }
+    return bad;
+}
+
+static void run_single(size_t n, size_t degree) {
+    const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+
+    fmt::print(
+        "impl,graph,n,edges,threads,delta,ms,rounds,scanned,mismatches\n");
+    for (std::string_view kind : {"random", "grid"}) {
+        const graph g = kind == "random" ? random_graph(n, degree, n)
+                                         : grid_graph(n, degree, n);
+        auto w = [&g](graph::edge_reference e) { return g.weight(e); };
+        auto print_row = [&](std::string_view impl, size_t threads,
+                             distance_t delta, double ms, size_t rounds,
+                             size_t scanned, size_t bad) {
+            fmt::print("{},{},{},{},{},{},{:.1f},{},{},{}\n", impl, kind,
+                       g.vertex_count(), g.edge_count(), threads, delta, ms,
+                       rounds, scanned, bad);
+        };
+        size_t rounds = 0;
+        size_t scanned = 0;
+        auto counting_w = [&](graph::edge_reference e) {
+            rounds += e.index == 0;
+            ++scanned;
+            return g.weight(e);
+        };
+
+        shortest_paths ref;
+        double ms = time_ms([&] { ref = bellman_ford(g, w, 0); });
+        bellman_ford(g, counting_w, 0);
+        print_row("bellman_ford", 1, 0, ms, rounds, scanned, 0);
+
+        spfa_result r;
+        ms = time_ms([&] { r = spfa(g, w, 0); });
+        scanned = 0;
+        spfa(g, counting_w, 0);
+        print_row("spfa", 1, 0, ms, 0, scanned, mismatches(g, ref, r.paths));
+
+        for (size_t threads = 1;; threads = std::min(2 * threads, hardware)) {
+            shortest_paths p;
+            const double ms = time_ms(
+                [&] { p = parallel_bellman_ford(g, w, 0, threads); });
+            print_row("parallel_bellman_ford", threads, 0, ms, 0, 0,
+                      mismatches(g, ref, p));
+            if (threads == hardware) break;
+        }
+
+        for (distance_t delta : {100, 1000, 10000}) {
+            shortest_paths p;
+            const double ms =
+                time_ms([&] { p = delta_stepping(g, w, 0, delta); });
+            print_row("delta_stepping", hardware, delta, ms, 0, 0,
+                      mismatches(g, ref, p));
+        }
+    }
+}
+
+static void run_multi(size_t n, size_t degree, size_t sources) {
+    fmt::print("impl,isa,graph,n,edges,sources,ms,ms_per_source,mismatches\n");
+    for (std::string_view kind : {"random", "grid"}) {
+        const graph g = kind == "random" ? random_graph(n, degree, n)
+                                         : grid_graph(n, degree, n);
+        auto w = [&g](graph::edge_reference e) { return g.weight(e); };
+        auto print_row = [&](std::string_view impl, std::string_view isa,
+                             double ms, size_t bad) {
+            fmt::print("{},{},{},{},{},{},{:.1f},{:.2f},{}\n", impl, isa,
+                       kind, g.vertex_count(), g.edge_count(), sources, ms,
+                       ms / sources, bad);
+        };
+
+        std::mt19937_64 rng{sources};
+        std::uniform_int_distribution<vid_t> vertex(
+            0, vid_t(g.vertex_count() - 1));
+        std::vector<vid_t> seeds(sources);
+        std::ranges::generate(seeds, [&] { return vertex(rng); });
+
+        std::vector<shortest_paths> ref(sources);
+        double ms = time_ms([&] {
+            for (size_t s = 0; s < sources; ++s) {
+                ref[s] = bellman_ford(g, w, seeds[s]);
+            }
+        });
+        print_row("bellman_ford", "scalar", ms, 0);
+
+        size_t bad = 0;
+        std::vector<spfa_result> r(sources);
+        ms = time_ms([&] {
+            for (size_t s = 0; s < sources; ++s) {
+                r[s] = spfa(g, w, seeds[s]);
+            }
+        });
+        for (size_t s = 0; s < sources; ++s) {
+            bad += mismatches(g, ref[s], r[s].paths);
+        }
+        print_row("spfa", "scalar", ms, bad);
+
+        for (auto isa :
+             {simd::isa::portable, simd::isa::avx2, simd::isa::avx512}) {
+            if (isa > simd::detected_isa()) continue;
+            simd::select_isa(isa);
+            std::optional<multi_source_paths> paths;
+            ms = time_ms([&] {
+                paths.emplace(multi_source_bellman_ford(
+                    g, w, std::span<const vid_t>(seeds)));
+            });
+            bad = 0;
+            for (size_t s = 0; s < sources; ++s) {
+                bad += mismatches(g, ref[s], paths->paths(s));
+            }
+            print_row("multi_source_bellman_ford", simd::to_string(isa), ms,
+                      bad);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string_view mode = "single";
+    int first = 1;
+    if (argc > 1 && !std::isdigit(static_cast<unsigned char>(argv[1][0]))) {
+        mode = argv[1];
+        ++first;
+    }
+    std::vector<size_t> args;
+    for (int i = first; i < argc; ++i) {
+        args.push_back(std::stoull(argv[i]));
+    }
+    auto arg = [&](size_t i, size_t fallback) {
+        return i < args.size() ? args[i] : fallback;
+    };
+    if (mode == "multi") {
+        run_multi(arg(0, size_t{1} << 16), arg(1, 16), arg(2, 64));
+        return 0;
+    }
+    if (mode != "single") {
+        fmt::print(stderr, "usage: {} [multi] [n] [degree] [sources]\n",
+                   argv[0]);
+        return 1;
+    }
+    run_single(arg(0, size_t{1} << 20), arg(1, 16));
+}
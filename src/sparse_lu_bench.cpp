@@ -0,0 +1,134 @@
+// Benchmarks for sparse_lu on g x g grid operators (five-point Laplacian
+// plus a random convection term, so A is unsymmetric). Prints CSV.
+//
+//     sparse_lu_bench [g]...
+//
+// dense:          lu_factorization on the same matrix, up to n = 4096.
+// natural:        sparse_lu with the columns in their given order, whose
+//                 fill is the matrix bandwidth g per row, up to g = 128.
+// minimum_degree: sparse_lu with the minimum degree column ordering.
+//
+// fill is the nonzeros of L and U, residual the largest |Ax - b|.
+
+#include <fmt/format.h>
+
+#include "dense_matrix.hpp"
+#include "lu_factorization.hpp"
+#include "sparse_lu.hpp"
+#include "sparse_matrix.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static csr_matrix<double> grid_operator(size_t g, std::uint64_t seed) {
+    std::mt19937_64 rng{seed};
+    std::uniform_real_distribution<double> convection(-0.5, 0.5);
+    std::vector<sparse_entry<double>> entries;
+    auto at = [g](size_t x, size_t y) { return uint32_t(y * g + x); };
+    for (size_t y = 0; y < g; ++y) {
+        for (size_t x = 0; x < g; ++x) {
+            const uint32_t i = at(x, y);
+            entries.push_back({i, i, 4.0});
+            if (x > 0) {
+                entries.push_back({i, at(x - 1, y), -1 + convection(rng)});
+            }
+            if (x + 1 < g) entries.push_back({i, at(x + 1, y), -1});
+            if (y > 0) {
+                entries.push_back({i, at(x, y - 1), -1 + convection(rng)});
+            }
+            if (y + 1 < g) entries.push_back({i, at(x, y + 1), -1});
+        }
+    }
+    return {g * g, g * g, std::move(entries)};
+}
+
+template <typename F>
+static double time_ms(F&& f) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    f();
+    auto stop = clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+static double max_residual(const csr_matrix<double>& A,
+                           const std::vector<double>& x,
+                           const std::vector<double>& b) {
+    std::vector<double> ax(b.size());
+    A.multiply(x, ax);
+    double residual = 0;
+    for (size_t i = 0; i < b.size(); ++i) {
+        residual = std::max(residual, std::abs(ax[i] - b[i]));
+    }
+    return residual;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> grids;
+    for (int i = 1; i < argc; ++i) {
+        grids.push_back(std::stoull(argv[i]));
+    }
+    if (grids.empty()) {
+        grids = {16, 32, 64, 128, 256};
+    }
+
+    fmt::print("impl,n,nonzeros,fill,order_ms,factor_ms,solve_ms,residual\n");
+    for (auto g : grids) {
+        const auto A = grid_operator(g, g);
+        const auto C = to_csc(A);
+        const size_t n = A.rows();
+        std::vector<double> b(n);
+        std::mt19937_64 rng{n};
+        std::uniform_real_distribution<double> d(-1, 1);
+        std::ranges::generate(b, [&] { return d(rng); });
+
+        auto print_row = [&](std::string_view impl, size_t fill,
+                             double order_ms, double factor_ms,
+                             double solve_ms, double residual) {
+            fmt::print("{},{},{},{},{:.2f},{:.2f},{:.3f},{:.3g}\n", impl, n,
+                       A.nonzeros(), fill, order_ms, factor_ms, solve_ms,
+                       residual);
+        };
+
+        if (n <= 4096) {
+            const auto dense = A.to_dense();
+            std::optional<lu_factorization<double>> lu;
+            const double factor_ms =
+                time_ms([&] { lu.emplace(dense.view()); });
+            auto x = b;
+            const double solve_ms =
+                time_ms([&] { lu->solve_in_place(std::span{x}); });
+            print_row("dense", n * n, 0, factor_ms, solve_ms,
+                      max_residual(A, x, b));
+        }
+
+        if (g <= 128) {
+            std::optional<sparse_lu<double>> lu;
+            const double factor_ms = time_ms([&] {
+                lu.emplace(C, sparse_lu<double>::ordering::natural);
+            });
+            std::vector<double> x;
+            const double solve_ms = time_ms([&] { x = lu->solve(b); });
+            print_row("natural", lu->fill(), 0, factor_ms, solve_ms,
+                      max_residual(A, x, b));
+        }
+
+        // Ordering time is part of the factorization; measured on its own
+        // to show its share.
+        const double order_ms =
+            time_ms([&] { (void)minimum_degree_ordering(C); });
+        std::optional<sparse_lu<double>> lu;
+        const double factor_ms = time_ms([&] { lu.emplace(C); });
+        std::vector<double> x;
+        const double solve_ms = time_ms([&] { x = lu->solve(b); });
+        print_row("minimum_degree", lu->fill(), order_ms,
+                  factor_ms - order_ms, solve_ms, max_residual(A, x, b));
+    }
+}
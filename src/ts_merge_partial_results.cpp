@@ -8,33 +8,41 @@
 
 #if PARALLEL
 #include <execution>
-#define SEQ std::execution::seq,
-#define PAR std::execution::par,
-#else
-#define SEQ
-#define PAR
 #endif
 
+#include "trace_event.hpp"
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdefaulted-function-deleted"
 #pragma GCC diagnostic ignored "-Wdeprecated-this-capture"
 #include <https://raw.githubusercontent.com/alice-viola/ThreadPool/master/threadpool.hpp>
 #pragma GCC diagnostic pop
 //
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <charconv>
 #include <chrono>
 #include <cstdint>
 #include <functional>
+#include <numeric>
+#include <optional>
 #include <random>
 #include <ranges>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
 #include <thread>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
-#ifndef THREAD_POOL_COUNT
-#define THREAD_POOL_COUNT std::thread::hardware_concurrency()
-#endif
-
 #ifdef USE_THIRDPARTY
 using fmt::format;
 using fmt::print;
@@ -50,12 +58,22 @@ using value_type = std::tuple<int>;
 using partial_result = std::unordered_map<key_type, value_type>;
 using final_result = std::vector<std::tuple<key_type, value_type>>;
 
-static inline partial_result generate_partial_results(
-    char prefix, size_t n, [[maybe_unused]] double unique_percentage) {
+// The first `duplicate_ratio * n` keys are shared by all partials (and thus
+// duplicated in the final result), the rest is unique to the partial.
+static inline partial_result generate_partial_results(size_t partial_index,
+                                                      size_t n,
+                                                      double duplicate_ratio) {
+    assert(duplicate_ratio >= 0.0 && duplicate_ratio <= 1.0);
+    const auto duplicate_count = static_cast<size_t>(duplicate_ratio * n);
+
     partial_result res;
     res.reserve(n);
     for (size_t i = 0; i < n; ++i) {
-        res.emplace(format("{}{}", prefix, i), std::make_tuple(i));
+        if (i < duplicate_count) {
+            res.emplace(format("dup{}", i), std::make_tuple(i));
+        } else {
+            res.emplace(format("p{}_{}", partial_index, i), std::make_tuple(i));
+        }
     }
     return res;
 }
@@ -70,11 +88,10 @@ static inline void inplace_merge(const partial_result& pr,
     }
 }
 
-#if defined(USE_THREAD_POOL) && USE_THREAD_POOL
-using thread_pool = astp::ThreadPool;
-#else
-struct thread_pool {
-    thread_pool(size_t thread_count = std::thread::hardware_concurrency()) {
+// Spawns one thread per pushed task, `thread_count` is only a capacity hint.
+struct thread_per_task_pool {
+    thread_per_task_pool(
+        size_t thread_count = std::thread::hardware_concurrency()) {
         _threads.reserve(thread_count);
     }
 
@@ -88,88 +105,404 @@ struct thread_pool {
    private:
     std::vector<std::thread> _threads;
 };
+
+#if defined(USE_THREAD_POOL) && USE_THREAD_POOL
+using thread_pool = astp::ThreadPool;
+#else
+using thread_pool = thread_per_task_pool;
 #endif
 
+// `policy` is an optional execution policy forwarded to the std algorithms.
+template <typename Pool = thread_pool, typename... ExecutionPolicy>
 static inline final_result merge_partial_results(
-    std::vector<partial_result> partial_results) {
+    std::vector<partial_result> partial_results, size_t thread_count,
+    ExecutionPolicy&&... policy) {
+    static_assert(sizeof...(ExecutionPolicy) <= 1);
+    MK_TRACE_SCOPE("merge_partial_results");
     final_result res;
 
-#ifndef NDEBUG
-    auto total_count = std::transform_reduce(
-        PAR partial_results.cbegin(), partial_results.cend(), std::size_t{0},
-        std::plus{}, std::mem_fn(&partial_result::size));
-#endif
-
     std::vector<size_t> counts(1 + partial_results.size());
-    [[maybe_unused]] auto out_it = std::transform_inclusive_scan(
-        PAR partial_results.cbegin(), partial_results.cend(),
-        counts.begin() + 1, std::plus{}, std::mem_fn(&partial_result::size),
-        std::size_t{0});
-    assert(out_it == counts.end());
-    assert(total_count == counts.back());
-    total_count = counts.back();
+    {
+        MK_TRACE_SCOPE("count");
+        [[maybe_unused]] auto out_it = std::transform_inclusive_scan(
+            policy..., partial_results.cbegin(), partial_results.cend(),
+            counts.begin() + 1, std::plus{},
+            std::mem_fn(&partial_result::size), std::size_t{0});
+        assert(out_it == counts.end());
+        assert(std::transform_reduce(policy..., partial_results.cbegin(),
+                                     partial_results.cend(), std::size_t{0},
+                                     std::plus{},
+                                     std::mem_fn(&partial_result::size)) ==
+               counts.back());
+    }
+    const auto total_count = counts.back();
 
-    res.resize(total_count);
+    {
+        MK_TRACE_SCOPE("resize");
+        res.resize(total_count);
+    }
 
-    auto p = thread_pool{/*max_threads=*/THREAD_POOL_COUNT};
+    auto p = Pool(thread_count);
     size_t count_index = 0;
     for (const auto& pr : partial_results) {
         size_t start_idx = counts[count_index];
         size_t end_idx = counts[count_index + 1];
         ++count_index;
 
-        print("merge [{}:{})\n", start_idx, end_idx);
         auto begin = res.begin();
         p.push([&pr, b = begin + start_idx, e = begin + end_idx]() {
+            MK_TRACE_SCOPE("inplace_merge");
             inplace_merge(pr, b, e);
         });
     }
-    p.wait();
+    {
+        MK_TRACE_SCOPE("wait");
+        p.wait();
+    }
     return res;
 }
 
-struct timer {
+//------------------------------------------------------------------------------
+// Benchmark driver
+//------------------------------------------------------------------------------
+
+enum class execution_mode { seq, par };
+enum class pool_kind { thread_per_task, astp };
+
+constexpr std::string_view to_string_view(execution_mode m) {
+    return m == execution_mode::seq ? "seq" : "par";
+}
+
+constexpr std::string_view to_string_view(pool_kind k) {
+    return k == pool_kind::thread_per_task ? "thread_per_task" : "astp";
+}
+
+// Calls `f(policy)` with the std::execution policy matching `mode`, or `f()`
+// when the parallel algorithms are not compiled in.
+template <typename F>
+static decltype(auto) with_execution_policy(execution_mode mode, F&& f) {
+#if PARALLEL
+    if (mode == execution_mode::par) {
+        return f(std::execution::par);
+    }
+    return f(std::execution::seq);
+#else
+    assert(mode == execution_mode::seq);
+    return f();
+#endif
+}
+
+template <typename F>
+static decltype(auto) with_pool(pool_kind kind, F&& f) {
+    if (kind == pool_kind::astp) {
+        return f(std::type_identity<astp::ThreadPool>{});
+    }
+    return f(std::type_identity<thread_per_task_pool>{});
+}
+
+struct bench_config {
+    size_t partial_count;
+    size_t partial_size;
+    double duplicate_ratio;
+    // Empty for pools that spawn a thread per task.
+    std::optional<size_t> thread_count;
+    execution_mode mode;
+    pool_kind pool;
+};
+
+struct bench_result {
+    bench_config config;
+    size_t entries;
+    size_t bytes;
+    std::chrono::nanoseconds best;
+    std::chrono::nanoseconds median;
+    long peak_rss_kib;
+};
+
+struct bench_options {
+    std::vector<size_t> partial_counts = {8, 32, 128};
+    std::vector<size_t> partial_sizes = {1'000, 20'000};
+    std::vector<double> duplicate_ratios = {0.0, 0.1, 0.5};
+    std::vector<size_t> thread_counts = {1,
+                                         std::thread::hardware_concurrency()};
+#if PARALLEL
+    std::vector<execution_mode> modes = {execution_mode::seq,
+                                         execution_mode::par};
+#else
+    std::vector<execution_mode> modes = {execution_mode::seq};
+#endif
+    std::vector<pool_kind> pools = {pool_kind::thread_per_task,
+                                    pool_kind::astp};
+    size_t repetitions = 5;
+    bool json = false;
+};
+
+// Bytes of key and value payload that a merge has to move into the result.
+static size_t payload_bytes(const std::vector<partial_result>& partials) {
+    size_t bytes = 0;
+    for (const auto& pr : partials) {
+        for (const auto& [k, v] : pr) {
+            bytes += k.size() + sizeof(v);
+        }
+    }
+    return bytes;
+}
+
+static bench_result run_one(const bench_config& config,
+                            const std::vector<partial_result>& partials,
+                            size_t repetitions) {
     using clock = std::chrono::steady_clock;
 
-    timer(std::string name) : _name{std::move(name)}, _start{clock::now()} {}
-    ~timer() {
-        namespace chr = std::chrono;
-        using presentation_unit = chr::duration<float, std::milli>;
+    std::vector<clock::duration> samples;
+    samples.reserve(repetitions);
+    size_t entries = 0;
+    for (size_t r = 0; r < repetitions; ++r) {
+        // Copy outside of the timed region, the merge consumes its input.
+        auto input = partials;
+        final_result fr;
 
+        auto start = clock::now();
+        fr = with_pool(config.pool, [&]<typename Pool>(
+                                        std::type_identity<Pool>) {
+            return with_execution_policy(config.mode, [&](auto&&... policy) {
+                return merge_partial_results<Pool>(
+                    std::move(input),
+                    config.thread_count.value_or(
+                        std::thread::hardware_concurrency()),
+                    policy...);
+            });
+        });
         auto stop = clock::now();
-        auto elapsed = stop - _start;
-        print("* {} elapsed: {}\n", _name,
-              chr::duration_cast<presentation_unit>(elapsed));
+
+        samples.push_back(stop - start);
+        entries = fr.size();
     }
 
-   private:
-    std::string _name;
-    clock::time_point _start;
-};
+    std::ranges::sort(samples);
+    return {
+        .config = config,
+        .entries = entries,
+        .bytes = payload_bytes(partials),
+        .best = samples.front(),
+        .median = samples[samples.size() / 2],
+        .peak_rss_kib = 0,
+    };
+}
 
-int main() {
-    constexpr size_t partial_count = 32;
-    std::vector<partial_result> partial_results;
-    partial_results.reserve(partial_count);
+// Runs `config` in a forked child, which generates its own partials, so that
+// the child's peak RSS belongs to this config alone rather than being the
+// high-water mark of everything measured before it.
+static bench_result run_isolated(const bench_config& config,
+                                 size_t repetitions) {
+    static_assert(std::is_trivially_copyable_v<bench_result>);
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::system_error(errno, std::generic_category(), "pipe");
+    }
+    const pid_t pid = fork();
+    if (pid < 0) {
+        throw std::system_error(errno, std::generic_category(), "fork");
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        int status = 1;
+        try {
+            std::vector<partial_result> partials;
+            partials.reserve(config.partial_count);
+            for (size_t i = 0; i < config.partial_count; ++i) {
+                partials.emplace_back(generate_partial_results(
+                    i, config.partial_size, config.duplicate_ratio));
+            }
+            const auto r = run_one(config, partials, repetitions);
+            status = write(fds[1], &r, sizeof r) == sizeof r ? 0 : 1;
+        } catch (...) {
+        }
+        _exit(status);
+    }
 
-    {
-        timer _("generate");
-        for (size_t i = 0; i < partial_count; ++i) {
-            partial_results.emplace_back(
-                generate_partial_results('a' + i, 2'000'0, 0.10));
+    close(fds[1]);
+    bench_result r;
+    const auto n = read(fds[0], &r, sizeof r);
+    close(fds[0]);
+    int status = 0;
+    rusage usage{};
+    wait4(pid, &status, 0, &usage);
+    if (n != sizeof r || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error(format(
+            "benchmark failed for {} partials of {}", config.partial_count,
+            config.partial_size));
+    }
+    r.peak_rss_kib = usage.ru_maxrss;
+    return r;
+}
+
+// The distinct thread counts to sweep for `pool`; thread_per_task_pool
+// takes none.
+static std::vector<std::optional<size_t>> pool_thread_counts(
+    const bench_options& opts, pool_kind pool) {
+    if (pool == pool_kind::thread_per_task) {
+        return {std::nullopt};
+    }
+    std::vector<std::optional<size_t>> counts;
+    for (auto n : opts.thread_counts) {
+        if (std::ranges::find(counts, n) == counts.end()) {
+            counts.emplace_back(n);
         }
     }
+    return counts;
+}
 
-    final_result fr;
-    {
-        timer _("merge");
-        fr = merge_partial_results(std::move(partial_results));
+static std::vector<bench_result> run_benchmarks(const bench_options& opts) {
+    std::vector<bench_result> results;
+    for (auto partial_count : opts.partial_counts) {
+        for (auto partial_size : opts.partial_sizes) {
+            for (auto duplicate_ratio : opts.duplicate_ratios) {
+                for (auto pool : opts.pools) {
+                    for (auto thread_count : pool_thread_counts(opts, pool)) {
+                        for (auto mode : opts.modes) {
+                            bench_config config{
+                                partial_count, partial_size, duplicate_ratio,
+                                thread_count,  mode,         pool,
+                            };
+                            results.push_back(
+                                run_isolated(config, opts.repetitions));
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return results;
+}
+
+static double per_second(size_t amount, std::chrono::nanoseconds elapsed) {
+    return amount / std::chrono::duration<double>(elapsed).count();
+}
+
+static std::string thread_count_string(const bench_config& c,
+                                       std::string_view none) {
+    return c.thread_count ? to_string(*c.thread_count) : std::string{none};
+}
+
+static void print_csv(const std::vector<bench_result>& results) {
+    print(
+        "partial_count,partial_size,duplicate_ratio,thread_count,execution,"
+        "pool,entries,bytes,best_ns,median_ns,entries_per_s,bytes_per_s,"
+        "peak_rss_kib\n");
+    for (const auto& r : results) {
+        const auto& c = r.config;
+        print("{},{},{},{},{},{},{},{},{},{},{:.0f},{:.0f},{}\n",
+              c.partial_count, c.partial_size, c.duplicate_ratio,
+              thread_count_string(c, "n/a"), to_string_view(c.mode),
+              to_string_view(c.pool), r.entries, r.bytes, r.best.count(),
+              r.median.count(), per_second(r.entries, r.best),
+              per_second(r.bytes, r.best), r.peak_rss_kib);
+    }
+}
+
+static void print_json(const std::vector<bench_result>& results) {
+    print("[\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        const auto& c = r.config;
+        print(
+            "  {{\"partial_count\": {}, \"partial_size\": {}, "
+            "\"duplicate_ratio\": {}, \"thread_count\": {}, "
+            "\"execution\": \"{}\", \"pool\": \"{}\", \"entries\": {}, "
+            "\"bytes\": {}, \"best_ns\": {}, \"median_ns\": {}, "
+            "\"entries_per_s\": {:.0f}, \"bytes_per_s\": {:.0f}, "
+            "\"peak_rss_kib\": {}}}{}\n",
+            c.partial_count, c.partial_size, c.duplicate_ratio,
+            thread_count_string(c, "null"), to_string_view(c.mode),
+            to_string_view(c.pool), r.entries, r.bytes,
+            r.best.count(), r.median.count(), per_second(r.entries, r.best),
+            per_second(r.bytes, r.best), r.peak_rss_kib,
+            i + 1 < results.size() ? "," : "");
+    }
+    print("]\n");
+}
+
+// Parses a comma separated list, e.g. "1,2,4".
+template <typename T, typename F>
+static std::vector<T> parse_list(std::string_view s, F&& parse_one) {
+    std::vector<T> res;
+    for (auto part : s | std::views::split(',')) {
+        res.push_back(parse_one(std::string_view{part.begin(), part.end()}));
     }
+    return res;
+}
 
-    print("final: size = {}, [\n", std::size(fr));
-    // for (const auto& v : fr) {
-    //     print("'{}': {{ {} }}\n", std::get<0>(v),
-    //     std::get<0>(std::get<1>(v)));
-    // }
-    // print("\n]");
+template <typename T>
+static T parse_number(std::string_view s) {
+    T v{};
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (ec != std::errc{} || ptr != s.data() + s.size()) {
+        throw std::invalid_argument(format("invalid number '{}'", s));
+    }
+    return v;
+}
+
+static bench_options parse_options(int argc, char** argv) {
+    bench_options opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        auto eq = arg.find('=');
+        auto key = arg.substr(0, eq);
+        auto value = eq == arg.npos ? std::string_view{} : arg.substr(eq + 1);
+
+        if (key == "--partials") {
+            opts.partial_counts =
+                parse_list<size_t>(value, parse_number<size_t>);
+        } else if (key == "--sizes") {
+            opts.partial_sizes =
+                parse_list<size_t>(value, parse_number<size_t>);
+        } else if (key == "--duplicates") {
+            opts.duplicate_ratios =
+                parse_list<double>(value, parse_number<double>);
+        } else if (key == "--threads") {
+            opts.thread_counts =
+                parse_list<size_t>(value, parse_number<size_t>);
+        } else if (key == "--exec") {
+            opts.modes =
+                parse_list<execution_mode>(value, [](std::string_view s) {
+                    if (s == "seq") return execution_mode::seq;
+#if PARALLEL
+                    if (s == "par") return execution_mode::par;
+#endif
+                    throw std::invalid_argument(
+                        format("unsupported execution mode '{}'", s));
+                });
+        } else if (key == "--pools") {
+            opts.pools = parse_list<pool_kind>(value, [](std::string_view s) {
+                if (s == "thread_per_task") return pool_kind::thread_per_task;
+                if (s == "astp") return pool_kind::astp;
+                throw std::invalid_argument(format("unknown pool '{}'", s));
+            });
+        } else if (key == "--reps") {
+            opts.repetitions = std::max<size_t>(1, parse_number<size_t>(value));
+        } else if (key == "--json") {
+            opts.json = true;
+        } else {
+            throw std::invalid_argument(format(
+                "unknown option '{}'\n"
+                "usage: {} [--partials=N,...] [--sizes=N,...] "
+                "[--duplicates=R,...] [--threads=N,...] [--exec=seq,par] "
+                "[--pools=thread_per_task,astp] [--reps=N] [--json]",
+                arg, argv[0]));
+        }
+    }
+    return opts;
+}
+
+int main(int argc, char** argv) try {
+    auto opts = parse_options(argc, argv);
+    auto results = run_benchmarks(opts);
+    if (opts.json) {
+        print_json(results);
+    } else {
+        print_csv(results);
+    }
+} catch (const std::exception& e) {
+    print(stderr, "error: {}\n", e.what());
+    return 1;
 }